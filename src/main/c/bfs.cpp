@@ -15,96 +15,49 @@
  */
 #include "GraphMatRuntime.h"
 #include "common.hpp"
+#include "bfs.hpp"
 
-#include <limits>
-#include <omp.h>
-#include <stdint.h>
-#include <algorithm>
 #include <iostream>
-#include <chrono>
 
 #ifdef GRANULA
 #include "granula.hpp"
 #endif
 
 using namespace std;
+using namespace bfs;
 
-typedef uint32_t depth_type;
-typedef depth_type msg_type;
-typedef depth_type reduce_type;
-
-struct vertex_value_type {
-    public:
-        depth_type curr;
-
-        vertex_value_type() {
-            curr = numeric_limits<depth_type>::max();
-        }
-
-        vertex_value_type(depth_type d) {
-            curr = d;
-        }
-
-        bool operator!= (const vertex_value_type& other) const {
-            return !(curr == other.curr);
-        }
-
-        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
-            if (v.curr != numeric_limits<depth_type>::max()) {
-                stream << v.curr;
-            } else {
-                stream << numeric_limits<int64_t>::max(); 
-            }
-
-            return stream;
-        }
-
-        depth_type get_output() {
-            return curr;
-        }
-};
-
-class BreadthFirstSearch: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
-    public:
-        depth_type current_depth;
-
-        BreadthFirstSearch() {
-            current_depth=1;
-    	    process_message_requires_vertexprop = false;
-        }
-
-        GraphMat::edge_direction getOrder() const {
-            return GraphMat::OUT_EDGES;
-        }
+/*
+ * Multi-source mode, used when more than one source vertex is given: the
+ * depths from every source are written to their own output file (see
+ * source_output_path). The processing window includes writing the output.
+ */
+static int multi_source_main(char *filename, const vector<int>& sources, char *output) {
+    bool is_master = GraphMat::get_global_myrank() == 0;
+    if (is_master) cout << "source vertices: " << sources.size() << endl;
 
-        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
-            msg = vertex.curr + 1;
-            return (vertex.curr == current_depth-1);
-        }
+    timer_start(is_master);
 
-        void reduce_function(reduce_type& total, const reduce_type& partial) const {
-            total = min(total, partial);
-        }
+    timer_next("load graph");
+    GraphMat::Graph<multi_source_value_type> graph;
+    load_graph(graph, filename);
 
-        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
-            result = msg;
+    timer_next("initialize engine");
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i] < 1 || sources[i] > graph.nvertices) {
+            cerr << "ERROR: invalid source vertex " << sources[i] << " (not in range [1, " << graph.nvertices << "]" << endl;
+            return EXIT_FAILURE;
         }
+    }
 
-        void apply(const reduce_type& msg, vertex_value_type& vertex) {
-            if(vertex.curr == numeric_limits<depth_type>::max())
-            {
-              vertex.curr = current_depth;
-            }
-        }
+    if (is_master) cout<< "Processing starts at: " + getEpoch() + "\n" <<endl;
+    timer_next("run algorithm");
+    run_multi_source(graph, sources, output);
+    if (is_master) cout<< "Processing ends at: " + getEpoch() + "\n" <<endl;
 
-        void do_every_iteration(int iteration_number) {
-            current_depth++;
-        }
-};
+    timer_end();
 
-string getEpoch() {
-    return to_string(chrono::duration_cast<chrono::milliseconds>
-        (chrono::system_clock::now().time_since_epoch()).count());
+    MPI_Finalize();
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[]) {
@@ -115,16 +68,26 @@ int main(int argc, char *argv[]) {
 
     MPI_Init(&argc, &argv);
     if (argc < 3) {
-        cerr << "usage: " << argv[0] << " <graph file> <source vertex> [output file]" << endl;
+        cerr << "usage: " << argv[0] << " <graph file> <source vertex | source,source,... | @source file>"
+             << " [job id] [output file]" << endl;
         return EXIT_FAILURE;
     }
 
     bool is_master = GraphMat::get_global_myrank() == 0;
     char *filename = argv[1];
-    int source_vertex = atoi(argv[2]);
+    vector<int> sources;
+    if (!parse_sources(argv[2], sources)) {
+        cerr << "ERROR: invalid source vertex list " << argv[2] << endl;
+        return EXIT_FAILURE;
+    }
+    int source_vertex = sources[0];
     string jobId = argc > 3 ? argv[3] : NULL;
     char *output = argc > 4 ? argv[4] : NULL;
 
+    if (sources.size() > 1) {
+        return multi_source_main(filename, sources, output);
+    }
+
     if (is_master) cout << "source vertex: " << source_vertex << endl;
 
     //nthreads = omp_get_max_threads();
@@ -145,21 +108,21 @@ int main(int argc, char *argv[]) {
     timer_next("load graph");
     GraphMat::Graph<vertex_value_type> graph;
     //graph.ReadMTX(filename);
-    graph.ReadGraphMatBin(filename);
+    load_graph(graph, filename);
 
 #ifdef GRANULA
     if (is_master) cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
 #endif
 
     timer_next("initialize engine");
-    if (source_vertex < 0 || source_vertex >= graph.nvertices) {
-        cerr << "ERROR: invalid source vertex (not in range [0, " << graph.nvertices-1 << "]" << endl;
+    if (source_vertex < 1 || source_vertex > graph.nvertices) {
+        cerr << "ERROR: invalid source vertex (not in range [1, " << graph.nvertices << "]" << endl;
         return EXIT_FAILURE;
     }
 
-    graph.setAllInactive();
-    graph.setVertexproperty(source_vertex, vertex_value_type(0));
-    graph.setActive(source_vertex);
+    initialize(graph, source_vertex);
+
+    direction_optimizer optimizer;
 
     BreadthFirstSearch prog;
     auto ctx = GraphMat::graph_program_init(prog, graph);
@@ -171,7 +134,8 @@ int main(int argc, char *argv[]) {
 
     if (is_master) cout<< "Processing starts at: " + getEpoch() + "\n" <<endl;
     timer_next("run algorithm");
-    GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, &ctx);
+    optimizer.open(filename);
+    optimizer.run(graph, prog, source_vertex, &ctx);
     if (is_master) cout<< "Processing ends at: " + getEpoch() + "\n" <<endl;
 
 
@@ -0,0 +1,562 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BFS_HPP
+#define BFS_HPP
+
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+
+namespace bfs {
+
+using namespace std;
+
+typedef uint32_t depth_type;
+typedef depth_type msg_type;
+typedef depth_type reduce_type;
+
+struct vertex_value_type {
+    public:
+        depth_type curr;
+        int32_t id;
+
+        vertex_value_type() {
+            curr = numeric_limits<depth_type>::max();
+            id = 0;
+        }
+
+        vertex_value_type(depth_type d, int32_t v = 0) {
+            curr = d;
+            id = v;
+        }
+
+        bool operator!= (const vertex_value_type& other) const {
+            return !(curr == other.curr);
+        }
+
+        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
+            if (v.curr != numeric_limits<depth_type>::max()) {
+                stream << v.curr;
+            } else {
+                stream << numeric_limits<int64_t>::max(); 
+            }
+
+            return stream;
+        }
+
+        depth_type get_output() {
+            return curr;
+        }
+};
+
+/*
+ * The vertices visited by the engine in one level, one list per thread.
+ */
+class level_vertices {
+    public:
+        vector<vector<int32_t> > lists;
+
+        level_vertices() : lists(omp_get_max_threads()) { }
+
+        void add(int32_t vertex) {
+            lists[omp_get_thread_num()].push_back(vertex);
+        }
+
+        void clear() {
+            for (size_t t = 0; t < lists.size(); t++) {
+                lists[t].clear();
+            }
+        }
+};
+
+class BreadthFirstSearch: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
+    public:
+        depth_type current_depth;
+        bitmap *visited;
+        level_vertices *level;
+
+        BreadthFirstSearch() {
+            current_depth=1;
+            visited = NULL;
+            level = NULL;
+    	    process_message_requires_vertexprop = false;
+        }
+
+        GraphMat::edge_direction getOrder() const {
+            return GraphMat::OUT_EDGES;
+        }
+
+        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
+            msg = vertex.curr + 1;
+            return (vertex.curr == current_depth-1);
+        }
+
+        void reduce_function(reduce_type& total, const reduce_type& partial) const {
+            total = min(total, partial);
+        }
+
+        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
+            result = msg;
+        }
+
+        void apply(const reduce_type& msg, vertex_value_type& vertex) {
+            bool unvisited = visited != NULL ? visited->test_and_set(vertex.id)
+                                             : vertex.curr == numeric_limits<depth_type>::max();
+            if (unvisited) {
+              vertex.curr = current_depth;
+              if (level != NULL) level->add(vertex.id);
+            }
+        }
+
+        void do_every_iteration(int iteration_number) {
+            current_depth++;
+        }
+};
+
+void initialize(GraphMat::Graph<vertex_value_type>& graph, int source_vertex) {
+    graph.setAllInactive();
+    for (int v = 1; v <= graph.getNumberOfVertices(); v++) {
+        if (graph.vertexNodeOwner(v)) {
+            graph.setVertexproperty(v, vertex_value_type(numeric_limits<depth_type>::max(), v));
+        }
+    }
+    graph.setVertexproperty(source_vertex, vertex_value_type(0, source_vertex));
+    graph.setActive(source_vertex);
+}
+
+/*
+ * Direction-optimizing BFS (Beamer et al.). Levels start out top-down, run by
+ * the engine over OUT_EDGES from the frontier. Once the edges leaving the
+ * frontier outnumber 1/alpha of the edges into unvisited vertices, levels are
+ * expanded bottom-up: every unvisited vertex scans its IN_EDGES and stops at
+ * the first parent found in the frontier. The search goes back to top-down
+ * once the frontier holds less than 1/beta of the vertices.
+ *
+ * Visited vertices are tracked in a bitmap rather than by their depth. In
+ * top-down levels every rank marks the vertices it owns. Bottom-up levels run
+ * on the in-edges of the image parts of this rank, with the visited set and
+ * the frontier combined across ranks after every level. Without a graph image
+ * that has degree arrays, every level is run top-down.
+ */
+class direction_optimizer {
+    public:
+        static const int64_t alpha = 15;
+        static const int64_t beta = 18;
+
+        direction_optimizer() : nvertices(0), nedges(0) { }
+
+        bool is_open() const {
+            return nvertices > 0;
+        }
+
+        bool open(const char *filename) {
+            if (!graph_degrees.is_open() || !is_graph_image(image_part_path(filename, 0))) {
+                return false;
+            }
+            graph_image_parts image;
+            image.open(filename);
+            return open(image);
+        }
+
+        bool open(const graph_image_parts& image) {
+            if (!graph_degrees.is_open()) {
+                return false;
+            }
+            in_edges.build(image, GraphMat::IN_EDGES);
+            long long local = in_edges.neighbors.size();
+            long long total = 0;
+            MPI_Allreduce(&local, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+            nedges = total;
+            nvertices = image.nvertices;
+            return true;
+        }
+
+        template <typename C>
+        void run(GraphMat::Graph<vertex_value_type>& graph, BreadthFirstSearch& prog, int source_vertex, C *ctx) {
+            visited.resize(graph.getNumberOfVertices() + 1);
+            visited.set(0);
+            visited.set(source_vertex);
+            prog.visited = &visited;
+
+            if (!is_open()) {
+                GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, ctx);
+                prog.visited = NULL;
+                return;
+            }
+
+            level_vertices level;
+            if (graph.vertexNodeOwner(source_vertex)) level.add(source_vertex);
+            prog.level = &level;
+            depth_type depth = 0;
+            int64_t unvisited_edges = nedges;
+            level_counts counts = count_level(level, unvisited_edges);
+            bool top_down = true;
+
+            while (counts.nvertices > 0) {
+                if (top_down && counts.frontier_edges > unvisited_edges / alpha) {
+                    frontier.resize(visited.size());
+                    for (size_t t = 0; t < level.lists.size(); t++) {
+                        for (size_t i = 0; i < level.lists[t].size(); i++) {
+                            frontier.set(level.lists[t][i]);
+                        }
+                    }
+                    frontier.allreduce_or();
+                    visited.allreduce_or();
+                    top_down = false;
+                } else if (!top_down && counts.nvertices < nvertices / beta) {
+                    graph.setAllInactive();
+                    frontier.for_each(activate_owned(graph));
+                    prog.current_depth = depth + 1;
+                    top_down = true;
+                }
+
+                depth++;
+                if (top_down) {
+                    level.clear();
+                    GraphMat::run_graph_program(&prog, graph, 1, ctx);
+                    counts = count_level(level, unvisited_edges);
+                } else {
+                    counts = bottom_up_step(graph, depth, unvisited_edges);
+                }
+            }
+
+            prog.visited = NULL;
+            prog.level = NULL;
+        }
+
+    private:
+        struct level_counts {
+            long long nvertices;
+            long long frontier_edges;
+        };
+
+        struct activate_owned {
+            GraphMat::Graph<vertex_value_type>& graph;
+
+            explicit activate_owned(GraphMat::Graph<vertex_value_type>& graph) : graph(graph) { }
+
+            void operator()(size_t v) const {
+                if (graph.vertexNodeOwner(v)) graph.setActive(v);
+            }
+        };
+
+        /*
+         * Sums up the size of a top-down level over all ranks.
+         */
+        level_counts count_level(const level_vertices& level, int64_t& unvisited_edges) {
+            long long counts[3] = { 0, 0, 0 };
+            for (size_t t = 0; t < level.lists.size(); t++) {
+                for (size_t i = 0; i < level.lists[t].size(); i++) {
+                    int32_t v = level.lists[t][i];
+                    counts[0]++;
+                    counts[1] += graph_degrees.out_degree(v);
+                    counts[2] += graph_degrees.in_degree(v);
+                }
+            }
+            MPI_Allreduce(MPI_IN_PLACE, counts, 3, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+            unvisited_edges -= counts[2];
+            level_counts result = { counts[0], counts[1] };
+            return result;
+        }
+
+        level_counts bottom_up_step(GraphMat::Graph<vertex_value_type>& graph, depth_type depth,
+                                    int64_t& unvisited_edges) {
+            next.resize(visited.size());
+            #pragma omp parallel for schedule(dynamic, 64)
+            for (size_t w = 0; w < visited.nwords(); w++) {
+                uint64_t candidates = ~visited.word(w);
+                if (w == visited.nwords() - 1 && visited.size() % 64 != 0) {
+                    candidates &= (1ULL << (visited.size() % 64)) - 1;
+                }
+                for (; candidates != 0; candidates &= candidates - 1) {
+                    int v = w * 64 + __builtin_ctzll(candidates);
+                    for (int64_t e = in_edges.offsets[v]; e < in_edges.offsets[v + 1]; e++) {
+                        if (frontier.get(in_edges.neighbors[e])) {
+                            next.set(v);
+                            break;
+                        }
+                    }
+                }
+            }
+            next.allreduce_or();
+            visited.or_with(next);
+
+            long long out_edges = 0;
+            long long in_edges_visited = 0;
+            #pragma omp parallel for schedule(dynamic, 64) reduction(+:out_edges, in_edges_visited)
+            for (size_t w = 0; w < next.nwords(); w++) {
+                for (uint64_t bits = next.word(w); bits != 0; bits &= bits - 1) {
+                    int v = w * 64 + __builtin_ctzll(bits);
+                    out_edges += graph_degrees.out_degree(v);
+                    in_edges_visited += graph_degrees.in_degree(v);
+                }
+            }
+            next.for_each(set_depth(graph, depth));
+            frontier.swap(next);
+
+            unvisited_edges -= in_edges_visited;
+            level_counts result = { (long long) frontier.count(), out_edges };
+            return result;
+        }
+
+        struct set_depth {
+            GraphMat::Graph<vertex_value_type>& graph;
+            depth_type depth;
+
+            set_depth(GraphMat::Graph<vertex_value_type>& graph, depth_type depth) : graph(graph), depth(depth) { }
+
+            void operator()(size_t v) const {
+                if (graph.vertexNodeOwner(v)) graph.setVertexproperty(v, vertex_value_type(depth, v));
+            }
+        };
+
+        int nvertices;
+        int64_t nedges;
+        local_csr in_edges;
+        bitmap visited;
+        bitmap frontier;
+        bitmap next;
+};
+
+/*
+ * Multi-source BFS (Then et al.): up to 64 searches share one traversal of
+ * the graph. Every vertex keeps a word with one bit per search that already
+ * reached it, and the bits of the searches that reached it in the last level.
+ * Messages carry those words, so a single pass over the edges advances all
+ * searches at once.
+ *
+ * Depths are not stored per vertex and search. Instead every vertex logs the
+ * searches that reach it in each level, and the depths of one search are
+ * filled in from the log when its output is written.
+ */
+typedef uint64_t source_mask;
+
+static const int sources_per_batch = 64;
+
+struct multi_source_value_type {
+    public:
+        source_mask seen;
+        source_mask next;
+        int32_t id;
+        depth_type depth;
+
+        multi_source_value_type(depth_type d = numeric_limits<depth_type>::max()) {
+            seen = 0;
+            next = 0;
+            id = 0;
+            depth = d;
+        }
+
+        bool operator!= (const multi_source_value_type& other) const {
+            return seen != other.seen || next != other.next;
+        }
+
+        friend ostream& operator<< (ostream& stream, const multi_source_value_type &v) {
+            if (v.depth != numeric_limits<depth_type>::max()) {
+                stream << v.depth;
+            } else {
+                stream << numeric_limits<int64_t>::max();
+            }
+
+            return stream;
+        }
+
+        depth_type get_output() {
+            return depth;
+        }
+};
+
+struct level_entry {
+    int32_t vertex;
+    depth_type depth;
+    source_mask sources;
+};
+
+/*
+ * The searches that reached each vertex, by level, one list per thread.
+ */
+class level_log {
+    public:
+        vector<vector<level_entry> > lists;
+
+        level_log() : lists(omp_get_max_threads()) { }
+
+        void add(int32_t vertex, depth_type depth, source_mask sources) {
+            level_entry entry = { vertex, depth, sources };
+            lists[omp_get_thread_num()].push_back(entry);
+        }
+};
+
+class MultiSourceBFS: public GraphMat::GraphProgram<source_mask, source_mask, multi_source_value_type> {
+    public:
+        depth_type current_depth;
+        level_log *log;
+
+        MultiSourceBFS(level_log *log) : current_depth(1), log(log) {
+            order = GraphMat::OUT_EDGES;
+            process_message_requires_vertexprop = false;
+        }
+
+        bool send_message(const multi_source_value_type& vertex, source_mask& msg) const {
+            msg = vertex.next;
+            return msg != 0;
+        }
+
+        void reduce_function(source_mask& total, const source_mask& partial) const {
+            total |= partial;
+        }
+
+        void process_message(const source_mask& msg, const int edge, const multi_source_value_type& vertex,
+                             source_mask& result) const {
+            result = msg;
+        }
+
+        void apply(const source_mask& total, multi_source_value_type& vertex) {
+            source_mask found = total & ~vertex.seen;
+            if (found != 0) {
+                vertex.seen |= found;
+                vertex.next = found;
+                log->add(vertex.id, current_depth, found);
+            }
+        }
+
+        void do_every_iteration(int iteration_number) {
+            current_depth++;
+        }
+};
+
+/*
+ * Parses a list of source vertices: either comma separated ids, or "@" and
+ * the name of a file with one id per line.
+ */
+inline bool parse_sources(const char *arg, vector<int>& sources) {
+    stringstream list;
+    if (arg[0] == '@') {
+        ifstream file(arg + 1);
+        if (!file) {
+            return false;
+        }
+        list << file.rdbuf();
+    } else {
+        string text(arg);
+        replace(text.begin(), text.end(), ',', ' ');
+        list << text;
+    }
+
+    sources.clear();
+    string token;
+    while (list >> token) {
+        char *end;
+        long source = strtol(token.c_str(), &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+        sources.push_back(source);
+    }
+    return !sources.empty();
+}
+
+/*
+ * The output file of one search of a multi-source run: the source id is
+ * inserted before the extension of a binary output file, and appended
+ * otherwise. Output to standard output stays there.
+ */
+inline string source_output_path(const char *output, int source) {
+    string path(output);
+    if (path == "-") {
+        return path;
+    }
+    stringstream suffix;
+    suffix << "." << source;
+    if (has_extension(output, OUTPUT_BINARY_EXTENSION)) {
+        path.insert(path.size() - strlen(OUTPUT_BINARY_EXTENSION), suffix.str());
+    } else {
+        path += suffix.str();
+    }
+    return path;
+}
+
+/*
+ * Runs a BFS from every source, in batches of sources_per_batch searches,
+ * and writes the depths of every search to its own output file.
+ */
+inline void run_multi_source(GraphMat::Graph<multi_source_value_type>& graph, const vector<int>& sources,
+                             const char *output) {
+    int nvertices = graph.getNumberOfVertices();
+    vector<depth_type> depths(nvertices + 1);
+
+    for (size_t first = 0; first < sources.size(); first += sources_per_batch) {
+        size_t batch = min(sources.size() - first, (size_t) sources_per_batch);
+
+        graph.setAllInactive();
+        multi_source_value_type initial;
+        for (int v = 1; v <= nvertices; v++) {
+            if (!graph.vertexNodeOwner(v)) continue;
+            initial.id = v;
+            graph.setVertexproperty(v, initial);
+        }
+
+        level_log log;
+        for (size_t i = 0; i < batch; i++) {
+            int source = sources[first + i];
+            if (!graph.vertexNodeOwner(source)) continue;
+            multi_source_value_type value = graph.getVertexproperty(source);
+            value.seen |= 1ULL << i;
+            value.next |= 1ULL << i;
+            graph.setVertexproperty(source, value);
+            graph.setActive(source);
+            log.add(source, 0, 1ULL << i);
+        }
+
+        MultiSourceBFS prog(&log);
+        auto ctx = GraphMat::graph_program_init(prog, graph);
+        GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, &ctx);
+        GraphMat::graph_program_clear(ctx);
+
+        if (output == NULL) continue;
+        for (size_t i = 0; i < batch; i++) {
+            fill(depths.begin(), depths.end(), numeric_limits<depth_type>::max());
+            for (size_t t = 0; t < log.lists.size(); t++) {
+                const vector<level_entry>& entries = log.lists[t];
+                for (size_t e = 0; e < entries.size(); e++) {
+                    if ((entries[e].sources >> i) & 1) depths[entries[e].vertex] = entries[e].depth;
+                }
+            }
+            for (int v = 1; v <= nvertices; v++) {
+                if (!graph.vertexNodeOwner(v)) continue;
+                multi_source_value_type value = graph.getVertexproperty(v);
+                value.depth = depths[v];
+                graph.setVertexproperty(v, value);
+            }
+            string path = source_output_path(output, sources[first + i]);
+            print_graph<multi_source_value_type, int, depth_type>(path.c_str(), graph, MPI_UNSIGNED);
+        }
+    }
+}
+
+}
+
+#endif
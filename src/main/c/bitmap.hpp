@@ -0,0 +1,171 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+
+#include <mpi.h>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+/*
+ * A set of vertex ids with one bit per vertex, used for visited sets and
+ * frontiers. Bits can be set from many threads at once with test_and_set;
+ * all other modifications must not race with each other.
+ *
+ * Bitmaps of all vertices are combined across ranks with allreduce_or, which
+ * sends sparse sets as lists of ids and dense sets as words, whichever is
+ * smaller.
+ */
+class bitmap {
+    public:
+        bitmap() : nbits(0) { }
+
+        explicit bitmap(size_t nbits) {
+            resize(nbits);
+        }
+
+        void resize(size_t n) {
+            nbits = n;
+            words.assign((n + 63) / 64, 0);
+        }
+
+        void swap(bitmap& other) {
+            std::swap(nbits, other.nbits);
+            words.swap(other.words);
+        }
+
+        size_t size() const {
+            return nbits;
+        }
+
+        size_t nwords() const {
+            return words.size();
+        }
+
+        uint64_t word(size_t w) const {
+            return words[w];
+        }
+
+        void clear() {
+            #pragma omp parallel for
+            for (size_t w = 0; w < words.size(); w++) {
+                words[w] = 0;
+            }
+        }
+
+        bool get(size_t i) const {
+            return (words[i >> 6] >> (i & 63)) & 1;
+        }
+
+        void set(size_t i) {
+            words[i >> 6] |= 1ULL << (i & 63);
+        }
+
+        /*
+         * Sets bit i and returns whether it was clear before. Safe to call
+         * from several threads at once.
+         */
+        bool test_and_set(size_t i) {
+            uint64_t mask = 1ULL << (i & 63);
+            if (words[i >> 6] & mask) {
+                return false;
+            }
+            return !(__sync_fetch_and_or(&words[i >> 6], mask) & mask);
+        }
+
+        size_t count() const {
+            size_t total = 0;
+            #pragma omp parallel for reduction(+:total)
+            for (size_t w = 0; w < words.size(); w++) {
+                total += __builtin_popcountll(words[w]);
+            }
+            return total;
+        }
+
+        void or_with(const bitmap& other) {
+            #pragma omp parallel for
+            for (size_t w = 0; w < words.size(); w++) {
+                words[w] |= other.words[w];
+            }
+        }
+
+        /*
+         * Calls f(i) for every set bit i, in increasing order.
+         */
+        template <typename F>
+        void for_each(F f) const {
+            for (size_t w = 0; w < words.size(); w++) {
+                for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                    f(w * 64 + __builtin_ctzll(bits));
+                }
+            }
+        }
+
+        /*
+         * Replaces the bitmap of every rank by the union of the bitmaps of
+         * all ranks.
+         */
+        void allreduce_or(MPI_Comm comm = MPI_COMM_WORLD) {
+            long long local = count();
+            long long total = 0;
+            MPI_Allreduce(&local, &total, 1, MPI_LONG_LONG, MPI_SUM, comm);
+
+            // An id takes 32 bits, so a list is only smaller than the bitmap
+            // if fewer than one in 32 bits are set.
+            if (total * 32 >= (long long) nbits || total > INT32_MAX) {
+                MPI_Allreduce(MPI_IN_PLACE, words.data(), words.size(), MPI_UINT64_T, MPI_BOR, comm);
+                return;
+            }
+
+            int nranks;
+            MPI_Comm_size(comm, &nranks);
+            std::vector<int> counts(nranks);
+            std::vector<int> displs(nranks, 0);
+            int local_count = local;
+            MPI_Allgather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+            for (int r = 1; r < nranks; r++) {
+                displs[r] = displs[r - 1] + counts[r - 1];
+            }
+
+            std::vector<uint32_t> ids;
+            ids.reserve(local);
+            for_each(push_id(ids));
+            std::vector<uint32_t> all(total);
+            MPI_Allgatherv(ids.data(), local_count, MPI_UINT32_T, all.data(), counts.data(), displs.data(),
+                           MPI_UINT32_T, comm);
+            for (size_t i = 0; i < all.size(); i++) {
+                set(all[i]);
+            }
+        }
+
+    private:
+        struct push_id {
+            std::vector<uint32_t>& ids;
+
+            explicit push_id(std::vector<uint32_t>& ids) : ids(ids) { }
+
+            void operator()(size_t i) const {
+                ids.push_back(i);
+            }
+        };
+
+        size_t nbits;
+        std::vector<uint64_t> words;
+};
+
+#endif
@@ -13,113 +13,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#include <limits>
-#include <omp.h>
-#include <stdint.h>
-#include <algorithm>
-#include <iostream>
-#include <chrono>
-#include "boost/serialization/vector.hpp"
-
 #include "GraphMatRuntime.h"
 #include "common.hpp"
+#include "cd.hpp"
+
+#include <iostream>
 
 #ifdef GRANULA
 #include "granula.hpp"
 #endif
 
 using namespace std;
-
-class custom_label_type;
-
-typedef int label_type;
-typedef label_type msg_type;
-
-template<typename T>
-class serializable_vector : public GraphMat::Serializable {
-  public:
-    std::vector<T> v;
-  public:
-    friend boost::serialization::access;
-    template<class Archive>
-    void serialize(Archive &ar, const unsigned int version) {
-      ar & v;
-    }
-};
-typedef serializable_vector<label_type> reduce_type;
-typedef custom_label_type vertex_value_type;
-
-class custom_label_type {
-    public:
-    	label_type label;
-	custom_label_type() : label(0) { }
-	custom_label_type(const int& x) : label(x) { }
-	bool operator!=(const custom_label_type& t) {
-		return label != t.label;
-	}
-	
-	label_type get_output() {
-		return label;
-	}
-	friend ostream& operator<<(ostream& out, const custom_label_type& t) {
-		out << t.label;
-		return out;
-	}
-};
-
-class CommunityDetectionProgram: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
-    public:
-        CommunityDetectionProgram(int isDirected) {
-            order = (isDirected)?(GraphMat::ALL_EDGES):(GraphMat::OUT_EDGES);
-            activity = GraphMat::ALL_VERTICES;
-	    process_message_requires_vertexprop = false;
-        }
-
-        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
-            msg = vertex.label;
-            return true;
-        }
-
-        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
-            result.v.clear();
-            result.v.push_back(msg);
-        }
-
-        void reduce_function(reduce_type& total, const reduce_type& partial) const {
-            total.v.insert(total.v.end(), partial.v.begin(), partial.v.end());
-        }
-
-        void apply(const reduce_type& total, vertex_value_type& vertex) {
-	    assert(total.v.size() > 0);
-	    if (total.v.size() == 1) {
-		vertex = total.v[0];
-	    } else {
-		auto total_copy = total;
-		std::sort(total_copy.v.begin(), total_copy.v.end());
-	    	int max_freq = 1;
-            	label_type max_freq_label = total_copy.v[0];
-		int curr_freq = 1;
-	    	for (int i = 1; i <total_copy.v.size(); i++) {
-			if (total_copy.v[i] == total_copy.v[i-1])  {
-			  curr_freq++;
-			  if (curr_freq > max_freq) {
-			    max_freq = curr_freq;
-			    max_freq_label = total_copy.v[i];
-                          }
-			} else {
-			  curr_freq = 1;
-			}
-	    	}
-            	vertex = max_freq_label;
-	    }
-        }
-};
-
-string getEpoch() {
-    return to_string(chrono::duration_cast<chrono::milliseconds>
-        (chrono::system_clock::now().time_since_epoch()).count());
-}
-
+using namespace cd;
 
 int main(int argc, char *argv[]) {
 
@@ -156,7 +61,7 @@ int main(int argc, char *argv[]) {
     timer_next("load graph");
     GraphMat::Graph<vertex_value_type> graph;
     //graph.ReadMTX(filename);
-    graph.ReadGraphMatBin(filename);
+    load_graph(graph, filename);
 
 #ifdef GRANULA
     cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
@@ -164,13 +69,10 @@ int main(int argc, char *argv[]) {
 
     timer_next("initialize engine");
 
-    for (size_t i = 1; i <= graph.getNumberOfVertices(); i++) {
-	if (graph.vertexNodeOwner(i)) {
-        	graph.setVertexproperty(i, label_type(i));
-	}
-    }
+    initialize(graph);
 
     CommunityDetectionProgram prog(isDirected);
+    label_propagation propagation;
     auto ctx = GraphMat::graph_program_init(prog, graph);
 
 #ifdef GRANULA
@@ -180,7 +82,8 @@ int main(int argc, char *argv[]) {
 
     if (is_master) cout<< "Processing starts at: " + getEpoch() + "\n" <<endl;
     timer_next("run algorithm");
-    GraphMat::run_graph_program(&prog, graph, niterations, &ctx);
+    propagation.open(filename);
+    propagation.run(graph, prog, niterations, &ctx);
     if (is_master) cout<< "Processing ends at: " + getEpoch() + "\n" <<endl;
 
 #ifdef GRANULA
@@ -193,7 +96,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     timer_next("print output");
-    print_graph<vertex_value_type, int, label_type>(output, graph, MPI_INT);
+    print_graph<vertex_value_type, int, label_type>(output, graph, MPI_INT, true);
 
 #ifdef GRANULA
     cout<<offloadGraph.getOperationInfo("EndTime", offloadGraph.getEpoch())<<endl;
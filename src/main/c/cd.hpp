@@ -0,0 +1,343 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CD_HPP
+#define CD_HPP
+
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+#include "boost/serialization/vector.hpp"
+
+#include "GraphMatRuntime.h"
+#include "bitmap.hpp"
+#include "common.hpp"
+#include "flat_serialization.hpp"
+
+namespace cd {
+
+using namespace std;
+
+class custom_label_type;
+
+typedef int label_type;
+typedef label_type msg_type;
+
+/*
+ * The labels of the neighbors of a vertex with how often each occurs, in
+ * order of first occurrence. Messages are merged by adding up the counts of
+ * equal labels, so the most frequent label is found in a single pass without
+ * sorting. Up to index_threshold labels are looked up by a linear scan; for
+ * more, as at hubs, an open-addressing index from label to position is built
+ * next to them. Only the labels and counts are serialized; the index is
+ * rebuilt on the receiving side when needed.
+ */
+struct label_count {
+    label_type label;
+    int count;
+
+    template<class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar & label;
+        ar & count;
+    }
+};
+
+class label_counts : public GraphMat::Serializable {
+    public:
+        static const size_t index_threshold = 16;
+
+        std::vector<label_count> entries;
+
+        void clear() {
+            entries.clear();
+            index.clear();
+        }
+
+        void add(label_type label, int count) {
+            if (entries.size() <= index_threshold) {
+                for (size_t i = 0; i < entries.size(); i++) {
+                    if (entries[i].label == label) {
+                        entries[i].count += count;
+                        return;
+                    }
+                }
+                append(label, count);
+                return;
+            }
+
+            if (index.empty()) {
+                rebuild_index(2 * entries.size());
+            }
+            size_t mask = index.size() - 1;
+            for (size_t slot = hash(label) & mask; ; slot = (slot + 1) & mask) {
+                if (index[slot] == 0) {
+                    index[slot] = entries.size() + 1;
+                    append(label, count);
+                    return;
+                }
+                if (entries[index[slot] - 1].label == label) {
+                    entries[index[slot] - 1].count += count;
+                    return;
+                }
+            }
+        }
+
+        void merge(const label_counts& other) {
+            for (size_t i = 0; i < other.entries.size(); i++) {
+                add(other.entries[i].label, other.entries[i].count);
+            }
+        }
+
+        friend boost::serialization::access;
+        template<class Archive>
+        void serialize(Archive &ar, const unsigned int version) {
+            serialize_flat(ar, entries);
+            index.clear();
+        }
+
+    private:
+        // Position + 1 of the entry of a label, 0 for an empty slot. Kept at
+        // most half full.
+        std::vector<int32_t> index;
+
+        static size_t hash(label_type label) {
+            return (uint32_t) label * 2654435761u;
+        }
+
+        void append(label_type label, int count) {
+            label_count entry = { label, count };
+            entries.push_back(entry);
+            if (!index.empty() && 2 * entries.size() > index.size()) {
+                rebuild_index(2 * index.size());
+            }
+        }
+
+        void rebuild_index(size_t min_size) {
+            size_t size = 64;
+            while (size < min_size) size *= 2;
+            index.assign(size, 0);
+            size_t mask = size - 1;
+            for (size_t i = 0; i < entries.size(); i++) {
+                size_t slot = hash(entries[i].label) & mask;
+                while (index[slot] != 0) slot = (slot + 1) & mask;
+                index[slot] = i + 1;
+            }
+        }
+};
+typedef label_counts reduce_type;
+typedef custom_label_type vertex_value_type;
+
+class custom_label_type {
+    public:
+    	label_type label;
+	int32_t id;
+	custom_label_type() : label(0), id(0) { }
+	custom_label_type(const int& x, int32_t v = 0) : label(x), id(v) { }
+	bool operator!=(const custom_label_type& t) {
+		return label != t.label;
+	}
+	
+	label_type get_output() {
+		return label;
+	}
+	friend ostream& operator<<(ostream& out, const custom_label_type& t) {
+		out << t.label;
+		return out;
+	}
+};
+
+// Ties between equally frequent labels go to the smallest original vertex id,
+// which need not be the smallest internal id once the graph is reordered.
+inline bool label_less(label_type a, label_type b) {
+    if (output_translation.is_open()) {
+        return output_translation.original_id(a) < output_translation.original_id(b);
+    }
+    return a < b;
+}
+
+/*
+ * One iteration of label propagation: every vertex takes the most frequent
+ * label among its neighbors. If changed is set, the vertices whose label
+ * changed are marked in it. If dirty is set, only the vertices marked in it
+ * take a new label; the others may receive the labels of only part of their
+ * neighbors and keep theirs. See label_propagation.
+ */
+class CommunityDetectionProgram: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
+    public:
+        bitmap *changed;
+        const bitmap *dirty;
+
+        CommunityDetectionProgram(int isDirected) {
+            order = (isDirected)?(GraphMat::ALL_EDGES):(GraphMat::OUT_EDGES);
+            activity = GraphMat::ALL_VERTICES;
+	    process_message_requires_vertexprop = false;
+            changed = NULL;
+            dirty = NULL;
+        }
+
+        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
+            msg = vertex.label;
+            return true;
+        }
+
+        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
+            result.clear();
+            result.add(msg, 1);
+        }
+
+        void reduce_function(reduce_type& total, const reduce_type& partial) const {
+            total.merge(partial);
+        }
+
+        void apply(const reduce_type& total, vertex_value_type& vertex) {
+            assert(total.entries.size() > 0);
+            if (dirty != NULL && !dirty->get(vertex.id)) {
+                return;
+            }
+            const label_count *best = &total.entries[0];
+            for (size_t i = 1; i < total.entries.size(); i++) {
+                const label_count& entry = total.entries[i];
+                if (entry.count > best->count || (entry.count == best->count && label_less(entry.label, best->label))) {
+                    best = &entry;
+                }
+            }
+            if (changed != NULL && best->label != vertex.label) {
+                changed->test_and_set(vertex.id);
+            }
+            vertex.label = best->label;
+        }
+};
+
+void initialize(GraphMat::Graph<vertex_value_type>& graph) {
+    for (size_t i = 1; i <= graph.getNumberOfVertices(); i++) {
+	if (graph.vertexNodeOwner(i)) {
+        	graph.setVertexproperty(i, vertex_value_type(i, i));
+	}
+    }
+}
+
+/*
+ * Runs label propagation for niterations, or until no label changes: from
+ * then on every iteration would give the same labels again. The number of
+ * changed labels is combined across ranks and reported per iteration.
+ *
+ * A label can only change if the label of a neighbor changed in the previous
+ * iteration, so after the first iteration only the neighbors of changed
+ * vertices (the dirty vertices) take a new label, and only their neighbors
+ * send. Both sets are found with bitmaps on the edges of the image parts of
+ * this rank, in both directions, and combined across ranks. Without a graph
+ * image every vertex sends in every iteration and only the early stop
+ * applies.
+ */
+class label_propagation {
+    public:
+        label_propagation() : nvertices(0) { }
+
+        bool is_open() const {
+            return nvertices > 0;
+        }
+
+        bool open(const char *filename) {
+            if (!is_graph_image(image_part_path(filename, 0))) {
+                return false;
+            }
+            graph_image_parts image;
+            image.open(filename);
+            return open(image);
+        }
+
+        bool open(const graph_image_parts& image) {
+            edges.build(image, GraphMat::ALL_EDGES);
+            nvertices = image.nvertices;
+            return true;
+        }
+
+        template <typename C>
+        void run(GraphMat::Graph<vertex_value_type>& graph, CommunityDetectionProgram& prog, int niterations, C *ctx) {
+            bool is_master = GraphMat::get_global_myrank() == 0;
+            size_t nbits = graph.getNumberOfVertices() + 1;
+            changed.resize(nbits);
+            prog.changed = &changed;
+            prog.dirty = NULL;
+            prog.activity = GraphMat::ALL_VERTICES;
+
+            for (int it = 0; it < niterations; it++) {
+                changed.clear();
+                GraphMat::run_graph_program(&prog, graph, 1, ctx);
+                changed.allreduce_or();
+
+                long long nchanged = changed.count();
+                if (is_master) cout << "iteration " << it + 1 << ": " << nchanged << " labels changed" << endl;
+                if (nchanged == 0) {
+                    break;
+                }
+                if (!is_open()) {
+                    continue;
+                }
+
+                dirty.resize(nbits);
+                senders.resize(nbits);
+                add_neighbors(changed, dirty);
+                add_neighbors(dirty, senders);
+                graph.setAllInactive();
+                senders.for_each(activate_owned(graph));
+                prog.dirty = &dirty;
+                prog.activity = GraphMat::ACTIVE_ONLY;
+            }
+
+            prog.changed = NULL;
+            prog.dirty = NULL;
+            prog.activity = GraphMat::ALL_VERTICES;
+        }
+
+    private:
+        int nvertices;
+        local_csr edges;
+        bitmap changed;
+        bitmap dirty;
+        bitmap senders;
+
+        struct activate_owned {
+            GraphMat::Graph<vertex_value_type>& graph;
+
+            explicit activate_owned(GraphMat::Graph<vertex_value_type>& graph) : graph(graph) { }
+
+            void operator()(size_t v) const {
+                if (graph.vertexNodeOwner(v)) graph.setActive(v);
+            }
+        };
+
+        // Replaces to by the neighbors of the vertices in from.
+        void add_neighbors(const bitmap& from, bitmap& to) {
+            to.clear();
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int v = 1; v <= nvertices; v++) {
+                if (!from.get(v)) {
+                    continue;
+                }
+                for (int64_t i = edges.offsets[v]; i < edges.offsets[v + 1]; i++) {
+                    to.test_and_set(edges.neighbors[i]);
+                }
+            }
+            to.allreduce_or();
+        }
+};
+
+}
+
+#endif
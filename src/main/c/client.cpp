@@ -0,0 +1,83 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * gmat-client sends a single request to a running gmat-server and prints the
+ * reply. It exits successfully iff the server answered "OK".
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " <socket path> <ping|quit|algorithm> [arguments]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+        cerr << "socket path is too long: " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, argv[1]);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*) &address, sizeof(address)) != 0) {
+        cerr << "failed to connect to " << argv[1] << ": " << strerror(errno) << endl;
+        return EXIT_FAILURE;
+    }
+
+    string request = argv[2];
+    for (int i = 3; i < argc; i++) {
+        request += " ";
+        request += argv[i];
+    }
+    request += "\n";
+    for (size_t done = 0; done < request.size(); ) {
+        ssize_t n = write(fd, request.data() + done, request.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            cerr << "failed to send request: " << strerror(errno) << endl;
+            return EXIT_FAILURE;
+        }
+        done += n;
+    }
+
+    string reply;
+    char buffer[4096];
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        reply.append(buffer, n);
+    }
+    close(fd);
+
+    cout << reply << flush;
+    size_t last_line = reply.size() >= 2 ? reply.rfind('\n', reply.size() - 2) : string::npos;
+    last_line = last_line == string::npos ? 0 : last_line + 1;
+    return reply.compare(last_line, string::npos, "OK\n") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -13,29 +13,237 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#ifndef COMMON_HPP
+#define COMMON_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstring>
 #include <fstream>
+#include <omp.h>
+#include <sstream>
 #include <ostream>
 #include <string>
 #include <sys/time.h>
 #include <vector>
 
-template <typename T, typename E=int, typename O>
-void print_graph(const char *filename, const GraphMat::Graph<T, E>& graph, MPI_Datatype mpi_datatype) {
-    if (filename == NULL || strlen(filename) == 0) {
+#include "bitmap.hpp"
+#include "graph_image.hpp"
+
+/*
+ * Original ids of the loaded graph. When the graph comes with a vertex
+ * translation, text output is written with the original ids, so it needs no
+ * post-processing.
+ */
+static vertex_translation output_translation;
+
+/*
+ * Degrees of the vertices of the loaded graph, if the graph image has them.
+ */
+static vertex_degrees graph_degrees;
+
+/*
+ * Maps the vertex translation and the degree arrays of a graph, where present.
+ */
+inline void load_graph_metadata(const char *filename) {
+    output_translation.open(vertex_translation_path(filename));
+    graph_degrees.open(image_part_path(filename, 0));
+}
+
+/*
+ * The parts of a graph image loaded by this rank. Rank r loads parts r,
+ * r + nranks, ... of the image, so an image converted with one part per rank
+ * is loaded by all ranks concurrently, each reading only its own shard. The
+ * parts stay mapped for as long as this object lives.
+ */
+class graph_image_parts {
+    public:
+        int nvertices;
+        int64_t nedges;
+        uint32_t value_type;
+        std::vector<mapped_image> parts;
+
+        graph_image_parts() : nvertices(0), nedges(0), value_type(IMAGE_DOUBLE) { }
+
+        void open(const char *filename) {
+            int rank = GraphMat::get_global_myrank();
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+            mapped_image first;
+            if (!first.open(image_part_path(filename, 0))) {
+                std::cerr << "failed to open graph image " << filename << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            uint32_t nparts = first.header().nparts;
+            nvertices = first.header().nvertices;
+            value_type = first.header().value_type;
+            first.close();
+
+            std::vector<mapped_image>((nparts + nranks - 1 - rank) / nranks).swap(parts);
+            nedges = 0;
+            for (size_t i = 0; i < parts.size(); i++) {
+                uint32_t part = rank + i * nranks;
+                if (!parts[i].open(image_part_path(filename, part))) {
+                    std::cerr << "failed to open part " << part << " of graph image " << filename << std::endl;
+                    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                nedges += parts[i].header().nedges;
+            }
+            if (nedges > INT_MAX) {
+                std::cerr << "graph image part is too large for a single rank" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+        }
+};
+
+/*
+ * Hands the edges of the loaded parts to the engine. When a rank owns exactly
+ * one part with matching edge type, the mapped file is passed as is, unless
+ * copy_edges is set. The engine may reorder the edges it is given in place,
+ * so a process that loads the same image more than once must copy them.
+ */
+template <typename V, typename E>
+void load_graph(GraphMat::Graph<V, E>& graph, const graph_image_parts& image, bool copy_edges = false) {
+    GMDP::edgelist_t<E> edgelist;
+    edgelist.m = image.nvertices;
+    edgelist.n = image.nvertices;
+    edgelist.nnz = image.nedges;
+
+    const std::vector<mapped_image>& parts = image.parts;
+    std::vector<GMDP::edge_t<E> > copy;
+    if (!copy_edges && parts.size() == 1 && parts[0].header().value_type == image_value_type_of<E>::value) {
+        static_assert(sizeof(GMDP::edge_t<E>) == sizeof(image_edge<E>), "edge layout mismatch");
+        edgelist.edges = (GMDP::edge_t<E>*) parts[0].edges();
+    } else {
+        copy.resize(image.nedges);
+        int64_t offset = 0;
+        for (size_t i = 0; i < parts.size(); i++) {
+            copy_image_edges(parts[i], copy.data() + offset);
+            offset += parts[i].header().nedges;
+        }
+        edgelist.edges = copy.data();
+    }
+
+    graph.ReadEdgelist(edgelist);
+}
+
+/*
+ * Sets up the vertices of a graph without any of its edges, for kernels that
+ * keep their own adjacency and use the engine only for the vertex values.
+ */
+template <typename V, typename E>
+void load_vertices(GraphMat::Graph<V, E>& graph, int nvertices) {
+    GMDP::edgelist_t<E> edgelist;
+    edgelist.m = nvertices;
+    edgelist.n = nvertices;
+    edgelist.nnz = 0;
+    edgelist.edges = NULL;
+    graph.ReadEdgelist(edgelist);
+}
+
+/*
+ * Loads a graph converted to the image format (see graph_image.hpp), falling
+ * back to GraphMat's own binary format for graphs converted by graph_convert.
+ * The metadata of the graph is mapped as well (see load_graph_metadata).
+ */
+template <typename V, typename E>
+void load_graph(GraphMat::Graph<V, E>& graph, const char *filename) {
+    load_graph_metadata(filename);
+
+    if (!is_graph_image(image_part_path(filename, 0))) {
+        graph.ReadGraphMatBin(filename);
         return;
     }
-    std::ostream *stream;
-    std::ofstream *file_stream;
-    if (GraphMat::get_global_myrank() == 0) {
-        if (strcmp(filename, "-") != 0) {
-            file_stream= new std::ofstream(filename);
-            stream= file_stream;
-        } else {
-            file_stream= NULL;
-            stream= &std::cout;
+
+    graph_image_parts image;
+    image.open(filename);
+    load_graph(graph, image);
+}
+
+/*
+ * The edges of the image parts loaded by this rank in compressed sparse row
+ * form, grouped by source (OUT_EDGES), by destination (IN_EDGES) or by both
+ * endpoints (ALL_EDGES, every edge listed under its source and under its
+ * destination), without edge values. The neighbors of vertex v are
+ * neighbors[offsets[v]] up to neighbors[offsets[v + 1]]. Ranks hold disjoint
+ * sets of edges, so anything computed from the local edges has to be combined
+ * across ranks.
+ */
+class local_csr {
+    public:
+        int nvertices;
+        std::vector<int64_t> offsets;
+        std::vector<int32_t> neighbors;
+
+        local_csr() : nvertices(0) { }
+
+        void build(const graph_image_parts& image, GraphMat::edge_direction direction) {
+            // Every edge record starts with the source and destination ids,
+            // whatever the value type of the image.
+            int first_key = direction == GraphMat::IN_EDGES ? 1 : 0;
+            int last_key = direction == GraphMat::OUT_EDGES ? 0 : 1;
+            nvertices = image.nvertices;
+
+            std::vector<int64_t> next(nvertices + 2, 0);
+            for (size_t p = 0; p < image.parts.size(); p++) {
+                const char *edges = image.parts[p].edges();
+                size_t stride = image_edge_size(image.parts[p].header().value_type);
+                int64_t n = image.parts[p].header().nedges;
+                #pragma omp parallel for
+                for (int64_t i = 0; i < n; i++) {
+                    const int32_t *edge = (const int32_t*) (edges + i * stride);
+                    for (int key = first_key; key <= last_key; key++) {
+                        #pragma omp atomic
+                        next[edge[key] + 1]++;
+                    }
+                }
+            }
+            for (int v = 1; v <= nvertices; v++) {
+                next[v + 1] += next[v];
+            }
+            offsets = next;
+            neighbors.resize(next[nvertices + 1]);
+
+            for (size_t p = 0; p < image.parts.size(); p++) {
+                const char *edges = image.parts[p].edges();
+                size_t stride = image_edge_size(image.parts[p].header().value_type);
+                int64_t n = image.parts[p].header().nedges;
+                #pragma omp parallel for
+                for (int64_t i = 0; i < n; i++) {
+                    const int32_t *edge = (const int32_t*) (edges + i * stride);
+                    for (int key = first_key; key <= last_key; key++) {
+                        neighbors[__sync_fetch_and_add(&next[edge[key]], 1)] = edge[1 - key];
+                    }
+                }
+            }
         }
+};
+
+/*
+ * Prints one line of text output. Vertex ids, and values that are vertex ids
+ * themselves, are translated to the original ids if a translation is loaded.
+ */
+template <typename T, typename O>
+void print_vertex(std::ostream& stream, int64_t id, const O& value, bool values_are_vertex_ids) {
+    if (output_translation.is_open()) {
+        stream << output_translation.original_id(id) << " ";
+        if (values_are_vertex_ids) {
+            stream << output_translation.original_id(value) << "\n";
+            return;
+        }
+    } else {
+        stream << id << " ";
     }
+    stream << T(value) << "\n";
+}
+
+/*
+ * Collects the output of all vertices on rank 0 and prints it to stdout.
+ */
+template <typename T, typename E, typename O>
+void gather_graph_output(const GraphMat::Graph<T, E>& graph, MPI_Datatype mpi_datatype, bool values_are_vertex_ids) {
     int mpi_size;
     int *id_buf_send;
     O *property_buf_send;
@@ -81,51 +289,224 @@ void print_graph(const char *filename, const GraphMat::Graph<T, E>& graph, MPI_D
     MPI_Gatherv(property_buf_send, nodes, mpi_datatype, property_buf_recv, recv_counts, displs, mpi_datatype, 0, MPI_COMM_WORLD);
     if (GraphMat::get_global_myrank() == 0) {
         for (int i = 0; i < nodes_sum; i++) {
-            (*stream) << id_buf_recv[i] << " " << T(property_buf_recv[i]) << std::endl;
+            print_vertex<T, O>(std::cout, id_buf_recv[i], property_buf_recv[i], values_are_vertex_ids);
         }
+        std::cout.flush();
 
         free(recv_counts);
         free(displs);
         free(id_buf_recv);
         free(property_buf_recv);
+    }
+
+    free(id_buf_send);
+    free(property_buf_send);
+}
 
-        if (file_stream != NULL) {
-            if (!file_stream->good()) {
-                std::cerr << "failed to write output to file" << endl;
+/*
+ * Writes the output of all vertices to a shared file. Every rank formats the
+ * vertices it owns with all its threads and writes them at its own offset
+ * through MPI-IO, so the file has the same contents as a gather on rank 0.
+ */
+template <typename T, typename E, typename O>
+void write_graph_output(const char *filename, const GraphMat::Graph<T, E>& graph, bool values_are_vertex_ids) {
+    int nthreads = omp_get_max_threads();
+    std::vector<std::string> chunks(nthreads);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int tid = omp_get_thread_num();
+        int64_t first = (int64_t) graph.nvertices * tid / nthreads + 1;
+        int64_t last = (int64_t) graph.nvertices * (tid + 1) / nthreads;
+
+        std::ostringstream stream;
+        for (int64_t i = first; i <= last; i++) {
+            if (graph.vertexNodeOwner(i)) {
+                T vertex_property = graph.getVertexproperty(i);
+                print_vertex<T, O>(stream, i, vertex_property.get_output(), values_are_vertex_ids);
             }
-    
-            file_stream->flush();
-            file_stream->close();
-            delete file_stream;
         }
+        chunks[tid] = stream.str();
+    }
 
+    long long size = 0;
+    for (int t = 0; t < nthreads; t++) {
+        size += chunks[t].size();
     }
 
-    free(id_buf_send);
-    free(property_buf_send);
+    long long offset = 0;
+    long long total = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (GraphMat::get_global_myrank() == 0) {
+        offset = 0;
+    }
 
+    MPI_File file;
+    int ok = MPI_File_open(MPI_COMM_WORLD, (char*) filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &file) == MPI_SUCCESS;
+    if (ok) {
+        ok = MPI_File_set_size(file, total) == MPI_SUCCESS;
+        for (int t = 0; ok && t < nthreads; t++) {
+            // Large buffers are written in pieces since MPI counts are ints.
+            const size_t max_piece = 1 << 30;
+            for (size_t done = 0; ok && done < chunks[t].size(); ) {
+                size_t piece = std::min(max_piece, chunks[t].size() - done);
+                MPI_Status status;
+                ok = MPI_File_write_at(file, offset, (void*) (chunks[t].data() + done), piece,
+                                       MPI_CHAR, &status) == MPI_SUCCESS;
+                offset += piece;
+                done += piece;
+            }
+        }
+        MPI_File_close(&file);
+    }
 
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!ok && GraphMat::get_global_myrank() == 0) {
+        std::cerr << "failed to write output to file" << std::endl;
+    }
 }
 
-bool get_bit(size_t idx, char* vec) {
-    size_t offset = idx >> 3;
-    size_t bit = idx & 0x7;
-    char mask = 1 << bit;
-    return (vec[offset] & mask) != 0;
+/*
+ * Binary output files hold a small header followed by two columns: the ids of
+ * all vertices as int32 and their values as the output type of the program.
+ * Columns are written in the same order as the text output.
+ */
+static const char OUTPUT_MAGIC[8] = { 'G', 'M', 'O', 'U', 'T', 'P', 'U', 'T' };
+static const uint32_t OUTPUT_VERSION = 1;
+static const char OUTPUT_BINARY_EXTENSION[] = ".bin";
+
+enum output_value_type {
+    OUTPUT_UINT32 = 0,
+    OUTPUT_INT32 = 1,
+    OUTPUT_DOUBLE = 2
+};
+
+template <typename O> struct output_value_type_of;
+template <> struct output_value_type_of<uint32_t> { static const uint32_t value = OUTPUT_UINT32; };
+template <> struct output_value_type_of<int32_t> { static const uint32_t value = OUTPUT_INT32; };
+template <> struct output_value_type_of<double> { static const uint32_t value = OUTPUT_DOUBLE; };
+
+struct output_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t value_type;
+    int64_t nvertices;
+};
+
+/*
+ * Writes the output of all vertices in the binary format. Like the text
+ * output, every rank writes the vertices it owns at its own offset of the
+ * shared file.
+ */
+template <typename T, typename E, typename O>
+void write_graph_binary(const char *filename, const GraphMat::Graph<T, E>& graph) {
+    int nthreads = omp_get_max_threads();
+    std::vector<int64_t> counts(nthreads + 1, 0);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int tid = omp_get_thread_num();
+        int64_t count = 0;
+        for (int64_t i = (int64_t) graph.nvertices * tid / nthreads + 1; i <= (int64_t) graph.nvertices * (tid + 1) / nthreads; i++) {
+            if (graph.vertexNodeOwner(i)) count++;
+        }
+        counts[tid + 1] = count;
+    }
+    for (int t = 0; t < nthreads; t++) {
+        counts[t + 1] += counts[t];
+    }
+
+    std::vector<int32_t> ids(counts[nthreads]);
+    std::vector<O> values(counts[nthreads]);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int tid = omp_get_thread_num();
+        int64_t next = counts[tid];
+        for (int64_t i = (int64_t) graph.nvertices * tid / nthreads + 1; i <= (int64_t) graph.nvertices * (tid + 1) / nthreads; i++) {
+            if (graph.vertexNodeOwner(i)) {
+                T vertex_property = graph.getVertexproperty(i);
+                ids[next] = i;
+                values[next] = vertex_property.get_output();
+                next++;
+            }
+        }
+    }
+
+    long long count = ids.size();
+    long long offset = 0;
+    long long total = 0;
+    MPI_Exscan(&count, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&count, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    bool is_master = GraphMat::get_global_myrank() == 0;
+    if (is_master) {
+        offset = 0;
+    }
+
+    output_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OUTPUT_MAGIC, sizeof(OUTPUT_MAGIC));
+    header.version = OUTPUT_VERSION;
+    header.value_type = output_value_type_of<O>::value;
+    header.nvertices = total;
+
+    MPI_Offset ids_offset = sizeof(header) + offset * sizeof(int32_t);
+    MPI_Offset values_offset = sizeof(header) + total * sizeof(int32_t) + offset * sizeof(O);
+
+    MPI_File file;
+    MPI_Status status;
+    int ok = MPI_File_open(MPI_COMM_WORLD, (char*) filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &file) == MPI_SUCCESS;
+    if (ok) {
+        ok = MPI_File_set_size(file, sizeof(header) + total * (sizeof(int32_t) + sizeof(O))) == MPI_SUCCESS;
+        if (ok && is_master) {
+            ok = MPI_File_write_at(file, 0, &header, sizeof(header), MPI_CHAR, &status) == MPI_SUCCESS;
+        }
+        // Large columns are written in pieces since MPI counts are ints.
+        const int64_t max_piece = 1 << 28;
+        for (int64_t done = 0; ok && done < count; done += max_piece) {
+            int piece = std::min<int64_t>(max_piece, count - done);
+            ok = MPI_File_write_at(file, ids_offset + done * sizeof(int32_t), &ids[done],
+                                   piece * sizeof(int32_t), MPI_CHAR, &status) == MPI_SUCCESS
+              && MPI_File_write_at(file, values_offset + done * sizeof(O), &values[done],
+                                   piece * sizeof(O), MPI_CHAR, &status) == MPI_SUCCESS;
+        }
+        MPI_File_close(&file);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!ok && is_master) {
+        std::cerr << "failed to write output to file" << std::endl;
+    }
 }
 
-bool set_bit(size_t idx, char* vec) {
-    size_t offset = idx >> 3;
-    size_t bit = idx & 0x7;
-    char mask = 1 << bit;
-    char val = vec[offset];
+inline bool has_extension(const char *filename, const char *extension) {
+    size_t length = strlen(filename);
+    size_t extension_length = strlen(extension);
+    return length >= extension_length && strcmp(filename + length - extension_length, extension) == 0;
+}
 
-    if (!(val & mask)) {
-        vec[offset] = val | mask;
-        return true;
+/*
+ * Prints the output of all vertices to stdout ("-"), to a text file, or to a
+ * binary file when the file name has the binary output extension. Binary
+ * output always uses the ids of the loaded graph.
+ */
+template <typename T, typename E=int, typename O>
+void print_graph(const char *filename, const GraphMat::Graph<T, E>& graph, MPI_Datatype mpi_datatype,
+                 bool values_are_vertex_ids = false) {
+    if (filename == NULL || strlen(filename) == 0) {
+        return;
     }
 
-    return false;
+    if (strcmp(filename, "-") == 0) {
+        gather_graph_output<T, E, O>(graph, mpi_datatype, values_are_vertex_ids);
+    } else if (has_extension(filename, OUTPUT_BINARY_EXTENSION)) {
+        write_graph_binary<T, E, O>(filename, graph);
+    } else {
+        write_graph_output<T, E, O>(filename, graph, values_are_vertex_ids);
+    }
 }
 
 double timer() {
@@ -164,3 +545,10 @@ void timer_end() {
         timers.clear();
     }
 }
+
+std::string getEpoch() {
+    return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+#endif
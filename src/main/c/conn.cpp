@@ -15,86 +15,16 @@
  */
 #include "GraphMatRuntime.h"
 #include "common.hpp"
+#include "conn.hpp"
 
-#include <limits>
-#include <omp.h>
-#include <stdint.h>
-#include <algorithm>
 #include <iostream>
-#include <chrono>
 
 #ifdef GRANULA
 #include "granula.hpp"
 #endif
 
 using namespace std;
-
-typedef int32_t component_type;
-typedef component_type msg_type;
-typedef component_type reduce_type;
-
-struct vertex_value_type {
-    public:
-        component_type curr;
-        component_type prev;
-
-        vertex_value_type(component_type id) {
-            curr = id;
-            prev = -1;
-        }
-
-        vertex_value_type() {
-            curr = -1;
-            prev = -1;
-        }
-
-        bool operator!=(const vertex_value_type& other) const {
-            return !(curr == other.curr && prev == other.prev);
-        }
-
-        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
-            stream << v.curr;
-            return stream;
-        }
-
-        component_type get_output() {
-            return curr;
-        }
-};
-
-
-class WeaklyConnectedComponents: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
-    public:
-        WeaklyConnectedComponents() {
-            order = GraphMat::ALL_EDGES;
-            activity = GraphMat::ACTIVE_ONLY;
-    	    process_message_requires_vertexprop = false;
-        }
-
-        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
-            msg = vertex.curr;
-            return vertex.curr != vertex.prev;
-        }
-
-        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
-            result = msg;
-        }
-
-        void reduce_function(reduce_type& total, const reduce_type& partial) const {
-            total = min(total, partial);
-        }
-
-        void apply(const reduce_type& total, vertex_value_type& vertex) {
-            vertex.prev = vertex.curr;
-            vertex.curr = min(vertex.curr, total);
-        }
-};
-
-string getEpoch() {
-    return to_string(chrono::duration_cast<chrono::milliseconds>
-        (chrono::system_clock::now().time_since_epoch()).count());
-}
-
+using namespace conn;
 
 int main(int argc, char *argv[]) {
 
@@ -131,20 +61,17 @@ int main(int argc, char *argv[]) {
     timer_next("load graph");
     GraphMat::Graph<vertex_value_type> graph;
     //graph.ReadMTX(filename);
-    graph.ReadGraphMatBin(filename);
+    load_graph(graph, filename);
 
 #ifdef GRANULA
     if (is_master) cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
 #endif
 
     timer_next("initialize engine");
-    for (size_t i = 1; i <= graph.nvertices; i++) {
-        graph.setVertexproperty(i, vertex_value_type(i));
-    }
-
-    graph.setAllActive();
+    initialize(graph);
 
     WeaklyConnectedComponents prog;
+    union_find components;
     auto ctx = GraphMat::graph_program_init(prog, graph);
 
 #ifdef GRANULA
@@ -154,7 +81,8 @@ int main(int argc, char *argv[]) {
 
     if (is_master) cout<<" Processing starts at: " + getEpoch() + "\n" <<endl;
     timer_next("run algorithm");
-    GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, &ctx);
+    components.open(filename);
+    components.run(graph, prog, &ctx);
     if (is_master) cout<< "Processing ends at: " + getEpoch() + "\n" <<endl;
 
 #ifdef GRANULA
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CONN_HPP
+#define CONN_HPP
+
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+
+namespace conn {
+
+using namespace std;
+
+typedef int32_t component_type;
+typedef component_type msg_type;
+typedef component_type reduce_type;
+
+struct vertex_value_type {
+    public:
+        component_type curr;
+
+        vertex_value_type(component_type id) {
+            curr = id;
+        }
+
+        vertex_value_type() {
+            curr = -1;
+        }
+
+        bool operator!=(const vertex_value_type& other) const {
+            return curr != other.curr;
+        }
+
+        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
+            stream << v.curr;
+            return stream;
+        }
+
+        component_type get_output() {
+            return curr;
+        }
+};
+
+
+/*
+ * Label propagation of the smallest vertex id. A vertex only sends its label
+ * in the iteration after the label went down: the engine keeps exactly these
+ * vertices in its active bitmap, so no previous label is stored per vertex.
+ */
+class WeaklyConnectedComponents: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type> {
+    public:
+        WeaklyConnectedComponents() {
+            order = GraphMat::ALL_EDGES;
+            activity = GraphMat::ACTIVE_ONLY;
+    	    process_message_requires_vertexprop = false;
+        }
+
+        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
+            msg = vertex.curr;
+            return true;
+        }
+
+        void process_message(const msg_type& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
+            result = msg;
+        }
+
+        void reduce_function(reduce_type& total, const reduce_type& partial) const {
+            total = min(total, partial);
+        }
+
+        void apply(const reduce_type& total, vertex_value_type& vertex) {
+            if (total < vertex.curr) {
+                vertex.curr = total;
+            }
+        }
+};
+
+void initialize(GraphMat::Graph<vertex_value_type>& graph) {
+    for (size_t i = 1; i <= graph.nvertices; i++) {
+        graph.setVertexproperty(i, vertex_value_type(i));
+    }
+
+    graph.setAllActive();
+}
+
+/*
+ * Union-find connected components after Afforest (Sutton et al.), run on the
+ * edges of the image parts of this rank in both directions. Every vertex is
+ * first linked to its first two neighbors, which already joins most of the
+ * largest component. The component that holds most of a random sample of
+ * vertices is then taken to be the largest one, and only vertices outside of
+ * it link the rest of their neighbors; an edge between the two sides is still
+ * linked from its other endpoint. Trees are flattened by pointer jumping
+ * after every phase.
+ *
+ * Roots are only ever hooked under smaller roots, so every component ends up
+ * labeled with its smallest vertex id, as label propagation labels it. The
+ * forests of the ranks are merged by taking the smallest label of every
+ * vertex over all ranks and linking each vertex to it in the local forest,
+ * until no rank finds a smaller root. This takes a handful of rounds rather
+ * than one superstep per hop of the longest path. Without a graph image, the
+ * components are found by label propagation in the engine.
+ */
+class union_find {
+    public:
+        static const int neighbor_rounds = 2;
+        static const int nsamples = 1024;
+
+        union_find() : nvertices(0) { }
+
+        bool is_open() const {
+            return nvertices > 0;
+        }
+
+        bool open(const char *filename) {
+            if (!is_graph_image(image_part_path(filename, 0))) {
+                return false;
+            }
+            graph_image_parts image;
+            image.open(filename);
+            return open(image);
+        }
+
+        bool open(const graph_image_parts& image) {
+            edges.build(image, GraphMat::ALL_EDGES);
+            nvertices = image.nvertices;
+            return true;
+        }
+
+        template <typename C>
+        void run(GraphMat::Graph<vertex_value_type>& graph, WeaklyConnectedComponents& prog, C *ctx) {
+            if (!is_open()) {
+                GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, ctx);
+                return;
+            }
+
+            comp.resize(nvertices + 1);
+            #pragma omp parallel for
+            for (int v = 0; v <= nvertices; v++) {
+                comp[v] = v;
+            }
+
+            link_local_edges();
+            merge_ranks();
+
+            for (int v = 1; v <= nvertices; v++) {
+                if (graph.vertexNodeOwner(v)) {
+                    graph.setVertexproperty(v, vertex_value_type(comp[v]));
+                }
+            }
+        }
+
+    private:
+        int nvertices;
+        local_csr edges;
+        vector<component_type> comp;
+
+        void link(component_type u, component_type v) {
+            component_type p1 = comp[u];
+            component_type p2 = comp[v];
+            while (p1 != p2) {
+                component_type high = max(p1, p2);
+                component_type low = min(p1, p2);
+                component_type p_high = comp[high];
+                if (p_high == low) {
+                    break;
+                }
+                if (p_high == high && __sync_bool_compare_and_swap(&comp[high], high, low)) {
+                    break;
+                }
+                p1 = comp[comp[high]];
+                p2 = comp[low];
+            }
+        }
+
+        void compress() {
+            #pragma omp parallel for schedule(dynamic, 16384)
+            for (int v = 1; v <= nvertices; v++) {
+                while (comp[comp[v]] != comp[v]) {
+                    comp[v] = comp[comp[v]];
+                }
+            }
+        }
+
+        component_type most_frequent_component() const {
+            unordered_map<component_type, int> counts;
+            mt19937 generator(27491095);
+            uniform_int_distribution<int> distribution(1, nvertices);
+            for (int i = 0; i < nsamples; i++) {
+                counts[comp[distribution(generator)]]++;
+            }
+
+            component_type best = 0;
+            int best_count = 0;
+            for (unordered_map<component_type, int>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+                if (it->second > best_count) {
+                    best = it->first;
+                    best_count = it->second;
+                }
+            }
+            return best;
+        }
+
+        void link_local_edges() {
+            for (int r = 0; r < neighbor_rounds; r++) {
+                #pragma omp parallel for schedule(dynamic, 16384)
+                for (int u = 1; u <= nvertices; u++) {
+                    if (edges.offsets[u] + r < edges.offsets[u + 1]) {
+                        link(u, edges.neighbors[edges.offsets[u] + r]);
+                    }
+                }
+                compress();
+            }
+
+            component_type largest = most_frequent_component();
+            #pragma omp parallel for schedule(dynamic, 16384)
+            for (int u = 1; u <= nvertices; u++) {
+                if (comp[u] == largest) {
+                    continue;
+                }
+                for (int64_t i = edges.offsets[u] + neighbor_rounds; i < edges.offsets[u + 1]; i++) {
+                    link(u, edges.neighbors[i]);
+                }
+            }
+            compress();
+        }
+
+        void merge_ranks() {
+            vector<component_type> global(comp.size());
+            while (true) {
+                MPI_Allreduce(comp.data(), global.data(), comp.size(), MPI_INT32_T, MPI_MIN, MPI_COMM_WORLD);
+
+                long long changed = 0;
+                #pragma omp parallel for schedule(dynamic, 16384)
+                for (int v = 1; v <= nvertices; v++) {
+                    if (comp[v] != global[v]) {
+                        link(v, global[v]);
+                    }
+                }
+                compress();
+
+                #pragma omp parallel for reduction(+:changed)
+                for (int v = 1; v <= nvertices; v++) {
+                    if (comp[v] != global[v]) changed++;
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+                if (changed == 0) {
+                    break;
+                }
+            }
+        }
+};
+
+}
+
+#endif
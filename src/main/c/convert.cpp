@@ -0,0 +1,842 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph_image.hpp"
+
+using namespace std;
+
+/*
+ * Converts a graph in Graphalytics' VE format (a vertex file and an edge file)
+ * into a graph image. Vertices are renumbered 1..N, in vertex file order or in
+ * the order picked by --reorder, and the original ids are written to the
+ * vertex translation file of the image, with its reverse in the vertex index.
+ */
+
+enum reorder_mode {
+    REORDER_NONE,
+    REORDER_DEGREE,
+    REORDER_RCM,
+    REORDER_COMMUNITY
+};
+
+struct convert_options {
+    bool selfloops;
+    bool duplicated_edges;
+    bool bidirectional;
+    bool edge_weights;
+    int edge_weight_type;
+    uint32_t nparts;
+    reorder_mode reorder;
+
+    convert_options() {
+        selfloops = true;
+        duplicated_edges = true;
+        bidirectional = false;
+        edge_weights = false;
+        edge_weight_type = 0;
+        nparts = 1;
+        reorder = REORDER_NONE;
+    }
+};
+
+static bool parse_reorder_mode(const string& value, reorder_mode& mode) {
+    if (value == "none") mode = REORDER_NONE;
+    else if (value == "degree") mode = REORDER_DEGREE;
+    else if (value == "rcm") mode = REORDER_RCM;
+    else if (value == "community") mode = REORDER_COMMUNITY;
+    else return false;
+
+    return true;
+}
+
+static bool parse_option(const char *arg, convert_options& opts) {
+    const char *value = strchr(arg, '=');
+    string name = value ? string(arg, value - arg) : string(arg);
+    value = value ? value + 1 : "1";
+
+    if (name == "--selfloops") opts.selfloops = atoi(value) != 0;
+    else if (name == "--duplicatededges") opts.duplicated_edges = atoi(value) != 0;
+    else if (name == "--bidirectional") opts.bidirectional = atoi(value) != 0;
+    else if (name == "--edgeweights") opts.edge_weights = atoi(value) != 0;
+    else if (name == "--edgeweighttype") opts.edge_weight_type = atoi(value);
+    else if (name == "--parts") opts.nparts = atoi(value);
+    else if (name == "--reorder") return parse_reorder_mode(value, opts.reorder);
+    else return false;
+
+    return true;
+}
+
+/*
+ * A text file mapped into memory and split into one chunk per thread. Chunk
+ * boundaries are moved to the next line start so no line is split.
+ */
+class mapped_text {
+    public:
+        const char *begin;
+        const char *end;
+        vector<const char*> chunks;
+
+        mapped_text() : begin(NULL), end(NULL), length(0) { }
+
+        ~mapped_text() {
+            if (length > 0) {
+                munmap((void*) begin, length);
+            }
+        }
+
+        bool open(const char *filename, int nchunks) {
+            int fd = ::open(filename, O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                cerr << "failed to open " << filename << endl;
+                return false;
+            }
+
+            length = st.st_size;
+            if (length > 0) {
+                void *addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr == MAP_FAILED) {
+                    ::close(fd);
+                    length = 0;
+                    cerr << "failed to map " << filename << endl;
+                    return false;
+                }
+                begin = (const char*) addr;
+                madvise(addr, length, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+            end = begin + length;
+
+            chunks.resize(nchunks + 1);
+            for (int i = 0; i < nchunks; i++) {
+                const char *p = begin + length / nchunks * i;
+                // A chunk that starts at the beginning, as in files shorter
+                // than the number of chunks, has no boundary to search for.
+                if (p > begin) {
+                    const char *eol = (const char*) memchr(p - 1, '\n', end - p + 1);
+                    p = eol ? eol + 1 : end;
+                }
+                chunks[i] = p;
+            }
+            chunks[nchunks] = end;
+            for (int i = nchunks - 1; i > 0; i--) {
+                chunks[i] = min(chunks[i], chunks[i + 1]);
+            }
+            return true;
+        }
+
+    private:
+        size_t length;
+};
+
+static inline const char* skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static inline const char* next_line(const char *p, const char *end) {
+    const char *eol = (const char*) memchr(p, '\n', end - p);
+    return eol ? eol + 1 : end;
+}
+
+static inline bool parse_int64(const char *&p, const char *end, int64_t& value) {
+    p = skip_blanks(p, end);
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    int64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+static inline bool parse_weight(const char *&p, const char *end, double& value) {
+    // Copy the token first: the mapped file is not NUL terminated.
+    p = skip_blanks(p, end);
+    char token[64];
+    size_t length = 0;
+    while (p + length < end && length < sizeof(token) - 1 && p[length] != ' '
+            && p[length] != '\t' && p[length] != '\r' && p[length] != '\n') {
+        token[length] = p[length];
+        length++;
+    }
+    token[length] = '\0';
+
+    char *next;
+    value = strtod(token, &next);
+    if (length == 0 || next != token + length) {
+        return false;
+    }
+    p += length;
+    return true;
+}
+
+static inline bool is_blank_line(const char *p, const char *end) {
+    p = skip_blanks(p, end);
+    return p == end || *p == '\n';
+}
+
+/*
+ * Open-addressing hash table from original vertex ids to new ids. Keys are
+ * claimed with a compare-and-swap, so vertices can be inserted from all
+ * threads at once; lookups only start after all inserts are done.
+ */
+class vertex_id_map {
+    public:
+        static const int64_t EMPTY = INT64_MIN;
+
+        explicit vertex_id_map(int64_t nvertices) {
+            size_t capacity = 16;
+            while (capacity < 2 * (size_t) nvertices) capacity <<= 1;
+            mask = capacity - 1;
+            keys.resize(capacity);
+            values.resize(capacity);
+
+            #pragma omp parallel for
+            for (size_t i = 0; i < capacity; i++) {
+                keys[i] = EMPTY;
+            }
+        }
+
+        bool insert(int64_t key, int32_t value) {
+            for (size_t slot = hash(key); ; slot = (slot + 1) & mask) {
+                int64_t current = keys[slot];
+                if (current == EMPTY) {
+                    if (__sync_bool_compare_and_swap(&keys[slot], EMPTY, key)) {
+                        values[slot] = value;
+                        return true;
+                    }
+                    current = keys[slot];
+                }
+                if (current == key) {
+                    return false;
+                }
+            }
+        }
+
+        int32_t find(int64_t key) const {
+            for (size_t slot = hash(key); ; slot = (slot + 1) & mask) {
+                if (keys[slot] == key) return values[slot];
+                if (keys[slot] == EMPTY) return 0;
+            }
+        }
+
+    private:
+        size_t hash(int64_t key) const {
+            uint64_t h = (uint64_t) key * 0x9E3779B97F4A7C15ULL;
+            return (h ^ (h >> 29)) & mask;
+        }
+
+        size_t mask;
+        vector<int64_t> keys;
+        vector<int32_t> values;
+};
+
+static bool read_vertices(const char *filename, vector<int64_t>& old_ids) {
+    int nthreads = omp_get_max_threads();
+    mapped_text text;
+    if (!text.open(filename, nthreads)) {
+        return false;
+    }
+
+    vector<int64_t> offsets(nthreads + 1, 0);
+    #pragma omp parallel for
+    for (int t = 0; t < nthreads; t++) {
+        int64_t count = 0;
+        for (const char *p = text.chunks[t]; p < text.chunks[t + 1]; p = next_line(p, text.chunks[t + 1])) {
+            if (!is_blank_line(p, text.chunks[t + 1])) count++;
+        }
+        offsets[t + 1] = count;
+    }
+    for (int t = 0; t < nthreads; t++) {
+        offsets[t + 1] += offsets[t];
+    }
+
+    if (offsets[nthreads] > INT32_MAX) {
+        cerr << "GraphMat does not support more than " << INT32_MAX << " vertices" << endl;
+        return false;
+    }
+
+    old_ids.resize(offsets[nthreads]);
+    bool ok = true;
+    #pragma omp parallel for reduction(&&:ok)
+    for (int t = 0; t < nthreads; t++) {
+        int64_t next = offsets[t];
+        const char *end = text.chunks[t + 1];
+        for (const char *p = text.chunks[t]; p < end; p = next_line(p, end)) {
+            if (is_blank_line(p, end)) continue;
+            const char *q = p;
+            if (!parse_int64(q, end, old_ids[next++])) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    if (!ok) {
+        cerr << "invalid line found in " << filename << endl;
+    }
+    return ok;
+}
+
+template <typename W>
+struct edge_buckets {
+    // Every part is split into buckets holding consecutive ranges of source
+    // vertices, so concatenating the buckets of a part in order yields the
+    // edges of that part.
+    image_partition partition;
+    uint32_t nbuckets;
+    uint32_t buckets_per_part;
+    vector<vector<image_edge<W> > > buckets;
+
+    edge_buckets(uint32_t nparts, int64_t n) : partition(nparts, n) {
+        buckets_per_part = max(1, 8 * omp_get_max_threads() / (int) nparts);
+        nbuckets = nparts * buckets_per_part;
+    }
+
+    uint32_t bucket_of(int32_t src, int32_t dst) const {
+        uint32_t sub = (int64_t) (src - 1) * partition.row_blocks * buckets_per_part / partition.nvertices
+                       % buckets_per_part;
+        return partition.part_of(src, dst) * buckets_per_part + sub;
+    }
+
+    int64_t nedges() const {
+        int64_t total = 0;
+        for (uint32_t b = 0; b < nbuckets; b++) {
+            total += buckets[b].size();
+        }
+        return total;
+    }
+};
+
+/*
+ * Moves edges from a number of unordered lists into the buckets they belong
+ * to, emptying the lists.
+ */
+template <typename W>
+static void scatter_edges(vector<vector<image_edge<W> > >& lists, edge_buckets<W>& result) {
+    int nlists = lists.size();
+    uint32_t nbuckets = result.nbuckets;
+    vector<int64_t> counts((size_t) nlists * nbuckets, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < nlists; t++) {
+        for (size_t i = 0; i < lists[t].size(); i++) {
+            counts[(size_t) t * nbuckets + result.bucket_of(lists[t][i].src, lists[t][i].dst)]++;
+        }
+    }
+
+    result.buckets.assign(nbuckets, vector<image_edge<W> >());
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t b = 0; b < nbuckets; b++) {
+        int64_t size = 0;
+        for (int t = 0; t < nlists; t++) {
+            int64_t count = counts[(size_t) t * nbuckets + b];
+            counts[(size_t) t * nbuckets + b] = size;
+            size += count;
+        }
+        result.buckets[b].resize(size);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < nlists; t++) {
+        int64_t *next = &counts[(size_t) t * nbuckets];
+        for (size_t i = 0; i < lists[t].size(); i++) {
+            uint32_t b = result.bucket_of(lists[t][i].src, lists[t][i].dst);
+            result.buckets[b][next[b]++] = lists[t][i];
+        }
+        vector<image_edge<W> >().swap(lists[t]);
+    }
+}
+
+template <typename W>
+static bool read_edges(const char *filename, const vertex_id_map& ids, const convert_options& opts,
+                       edge_buckets<W>& result) {
+    int nthreads = omp_get_max_threads();
+    mapped_text text;
+    if (!text.open(filename, nthreads)) {
+        return false;
+    }
+
+    vector<vector<image_edge<W> > > local(nthreads);
+    bool ok = true;
+    #pragma omp parallel for reduction(&&:ok)
+    for (int t = 0; t < nthreads; t++) {
+        const char *end = text.chunks[t + 1];
+        for (const char *p = text.chunks[t]; p < end; p = next_line(p, end)) {
+            if (is_blank_line(p, end)) continue;
+
+            const char *q = p;
+            int64_t old_src, old_dst;
+            double weight = 1;
+            if (!parse_int64(q, end, old_src) || !parse_int64(q, end, old_dst)
+                    || (opts.edge_weights && !parse_weight(q, end, weight))) {
+                ok = false;
+                break;
+            }
+
+            int32_t src = ids.find(old_src);
+            int32_t dst = ids.find(old_dst);
+            if (src == 0 || dst == 0) {
+                #pragma omp critical
+                cerr << "edge (" << old_src << "," << old_dst << ") is invalid since vertex ids are unknown" << endl;
+                ok = false;
+                break;
+            }
+
+            if (!opts.selfloops && src == dst) continue;
+            image_edge<W> e = { src, dst, (W) weight };
+            local[t].push_back(e);
+            if (opts.bidirectional && src != dst) {
+                swap(e.src, e.dst);
+                local[t].push_back(e);
+            }
+        }
+    }
+    if (!ok) {
+        cerr << "invalid line found in " << filename << endl;
+        return false;
+    }
+
+    scatter_edges(local, result);
+    return true;
+}
+
+template <typename W>
+static bool edge_less(const image_edge<W>& a, const image_edge<W>& b) {
+    return a.src < b.src || (a.src == b.src && a.dst < b.dst);
+}
+
+template <typename W>
+static bool edge_equal(const image_edge<W>& a, const image_edge<W>& b) {
+    return a.src == b.src && a.dst == b.dst;
+}
+
+/*
+ * Counts the out-degree and in-degree of every vertex in the converted graph.
+ * The result holds the out-degrees followed by the in-degrees.
+ */
+template <typename W>
+static vector<int32_t> count_degrees(int64_t nvertices, const edge_buckets<W>& edges) {
+    vector<int32_t> degrees(2 * nvertices, 0);
+    int32_t *out_degrees = degrees.data() - 1;
+    int32_t *in_degrees = degrees.data() + nvertices - 1;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t b = 0; b < edges.nbuckets; b++) {
+        const vector<image_edge<W> >& bucket = edges.buckets[b];
+        for (size_t i = 0; i < bucket.size(); i++) {
+            #pragma omp atomic
+            out_degrees[bucket[i].src]++;
+            #pragma omp atomic
+            in_degrees[bucket[i].dst]++;
+        }
+    }
+
+    return degrees;
+}
+
+/*
+ * The undirected, simple version of the graph used to pick a vertex order:
+ * the neighbors of vertex v (0-based) are neighbors[offsets[v]] up to
+ * neighbors[offsets[v] + degree[v]], sorted and without duplicates.
+ */
+struct adjacency {
+    vector<int64_t> offsets;
+    vector<int32_t> degree;
+    vector<int32_t> neighbors;
+};
+
+template <typename W>
+static void build_adjacency(int64_t nvertices, const edge_buckets<W>& edges, adjacency& adj) {
+    vector<int64_t> next(nvertices + 1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t b = 0; b < edges.nbuckets; b++) {
+        const vector<image_edge<W> >& bucket = edges.buckets[b];
+        for (size_t i = 0; i < bucket.size(); i++) {
+            if (bucket[i].src == bucket[i].dst) continue;
+            #pragma omp atomic
+            next[bucket[i].src]++;
+            #pragma omp atomic
+            next[bucket[i].dst]++;
+        }
+    }
+    for (int64_t v = 0; v < nvertices; v++) {
+        next[v + 1] += next[v];
+    }
+    adj.offsets.assign(next.begin(), next.end() - 1);
+    adj.neighbors.resize(next[nvertices]);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t b = 0; b < edges.nbuckets; b++) {
+        const vector<image_edge<W> >& bucket = edges.buckets[b];
+        for (size_t i = 0; i < bucket.size(); i++) {
+            int32_t src = bucket[i].src - 1;
+            int32_t dst = bucket[i].dst - 1;
+            if (src == dst) continue;
+            adj.neighbors[__sync_fetch_and_add(&adj.offsets[src], 1)] = dst;
+            adj.neighbors[__sync_fetch_and_add(&adj.offsets[dst], 1)] = src;
+        }
+    }
+
+    adj.degree.resize(nvertices);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t v = 0; v < nvertices; v++) {
+        int32_t *first = adj.neighbors.data() + next[v];
+        int32_t *last = adj.neighbors.data() + next[v + 1];
+        sort(first, last);
+        adj.offsets[v] = next[v];
+        adj.degree[v] = unique(first, last) - first;
+    }
+}
+
+struct degree_greater {
+    const vector<int32_t>& degree;
+
+    explicit degree_greater(const vector<int32_t>& degree) : degree(degree) { }
+
+    bool operator()(int32_t a, int32_t b) const {
+        return degree[a] > degree[b] || (degree[a] == degree[b] && a < b);
+    }
+};
+
+struct degree_less {
+    const vector<int32_t>& degree;
+
+    explicit degree_less(const vector<int32_t>& degree) : degree(degree) { }
+
+    bool operator()(int32_t a, int32_t b) const {
+        return degree[a] < degree[b] || (degree[a] == degree[b] && a < b);
+    }
+};
+
+/*
+ * Hubs first: the vertices with the most edges end up next to each other, so
+ * their values share cache lines.
+ */
+static void degree_order(const vector<int32_t>& degree, vector<int32_t>& order) {
+    sort(order.begin(), order.end(), degree_greater(degree));
+}
+
+/*
+ * Reverse Cuthill-McKee: a breadth-first numbering started from a low degree
+ * vertex of every component, visiting neighbors by increasing degree. This
+ * keeps the ids of neighboring vertices close together.
+ */
+static void rcm_order(const adjacency& adj, vector<int32_t>& order) {
+    int64_t nvertices = order.size();
+    vector<int32_t> starts(order);
+    sort(starts.begin(), starts.end(), degree_less(adj.degree));
+
+    vector<char> visited(nvertices, 0);
+    int64_t size = 0;
+    for (int64_t s = 0; s < nvertices; s++) {
+        if (visited[starts[s]]) continue;
+        visited[starts[s]] = 1;
+        order[size++] = starts[s];
+
+        for (int64_t head = size - 1; head < size; head++) {
+            int32_t v = order[head];
+            int64_t first = size;
+            for (int32_t i = 0; i < adj.degree[v]; i++) {
+                int32_t u = adj.neighbors[adj.offsets[v] + i];
+                if (!visited[u]) {
+                    visited[u] = 1;
+                    order[size++] = u;
+                }
+            }
+            sort(order.begin() + first, order.begin() + size, degree_less(adj.degree));
+        }
+    }
+
+    reverse(order.begin(), order.end());
+}
+
+struct community_less {
+    const vector<int32_t>& label;
+    const vector<int32_t>& degree;
+
+    community_less(const vector<int32_t>& label, const vector<int32_t>& degree) : label(label), degree(degree) { }
+
+    bool operator()(int32_t a, int32_t b) const {
+        if (label[a] != label[b]) return label[a] < label[b];
+        return degree[a] > degree[b] || (degree[a] == degree[b] && a < b);
+    }
+};
+
+/*
+ * Groups vertices by community, found with a few rounds of label propagation
+ * on the undirected graph. Within a community the vertices are ordered by
+ * decreasing degree.
+ */
+static void community_order(const adjacency& adj, vector<int32_t>& order) {
+    const int max_rounds = 10;
+    int64_t nvertices = order.size();
+    vector<int32_t> label(order);
+    vector<int32_t> next(nvertices);
+
+    for (int round = 0; round < max_rounds; round++) {
+        int64_t changed = 0;
+        #pragma omp parallel reduction(+:changed)
+        {
+            vector<int32_t> labels;
+            #pragma omp for schedule(dynamic, 1024)
+            for (int64_t v = 0; v < nvertices; v++) {
+                // The vertex votes for its own label as well, which keeps
+                // the propagation from oscillating between two labels.
+                labels.assign(1, label[v]);
+                for (int32_t i = 0; i < adj.degree[v]; i++) {
+                    labels.push_back(label[adj.neighbors[adj.offsets[v] + i]]);
+                }
+                sort(labels.begin(), labels.end());
+
+                int32_t best = labels[0];
+                size_t best_count = 0;
+                for (size_t i = 0, j; i < labels.size(); i = j) {
+                    for (j = i + 1; j < labels.size() && labels[j] == labels[i]; j++) { }
+                    if (j - i > best_count) {
+                        best = labels[i];
+                        best_count = j - i;
+                    }
+                }
+
+                next[v] = best;
+                if (best != label[v]) changed++;
+            }
+        }
+
+        label.swap(next);
+        if (changed == 0) break;
+    }
+
+    sort(order.begin(), order.end(), community_less(label, adj.degree));
+}
+
+/*
+ * Renumbers the vertices in the order picked by the reorder option. Edges are
+ * relabeled and moved to the buckets they now belong to, and the vertex
+ * translation is permuted along, so later steps never see the old numbering.
+ */
+template <typename W>
+static void reorder_vertices(reorder_mode mode, vector<int64_t>& old_ids, edge_buckets<W>& edges) {
+    int64_t nvertices = old_ids.size();
+    vector<int32_t> order(nvertices);
+    for (int64_t v = 0; v < nvertices; v++) {
+        order[v] = v;
+    }
+
+    if (mode == REORDER_DEGREE) {
+        vector<int32_t> degrees = count_degrees(nvertices, edges);
+        vector<int32_t> degree(nvertices);
+        for (int64_t v = 0; v < nvertices; v++) {
+            degree[v] = degrees[v] + degrees[nvertices + v];
+        }
+        degree_order(degree, order);
+    } else {
+        adjacency adj;
+        build_adjacency(nvertices, edges, adj);
+        if (mode == REORDER_RCM) {
+            rcm_order(adj, order);
+        } else {
+            community_order(adj, order);
+        }
+    }
+
+    // new_id[v] is the 1-based id that old vertex v + 1 gets.
+    vector<int32_t> new_id(nvertices);
+    vector<int64_t> new_old_ids(nvertices);
+    #pragma omp parallel for
+    for (int64_t i = 0; i < nvertices; i++) {
+        new_id[order[i]] = i + 1;
+        new_old_ids[i] = old_ids[order[i]];
+    }
+    old_ids.swap(new_old_ids);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint32_t b = 0; b < edges.nbuckets; b++) {
+        vector<image_edge<W> >& bucket = edges.buckets[b];
+        for (size_t i = 0; i < bucket.size(); i++) {
+            bucket[i].src = new_id[bucket[i].src - 1];
+            bucket[i].dst = new_id[bucket[i].dst - 1];
+        }
+    }
+
+    vector<vector<image_edge<W> > > lists;
+    lists.swap(edges.buckets);
+    scatter_edges(lists, edges);
+}
+
+template <typename W>
+static bool write_image(const char *output, int64_t nvertices, const convert_options& opts, edge_buckets<W>& edges,
+                        const vector<int32_t>& degrees) {
+    int64_t total = edges.nedges();
+    for (uint32_t part = 0; part < opts.nparts; part++) {
+        image_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+        header.version = IMAGE_VERSION;
+        header.value_type = image_value_type_of<W>::value;
+        header.part = part;
+        header.nparts = opts.nparts;
+        header.nvertices = nvertices;
+        header.row_blocks = edges.partition.row_blocks;
+        header.total_nedges = total;
+        header.edges_offset = IMAGE_HEADER_SIZE;
+
+        uint32_t first = part * edges.buckets_per_part;
+        uint32_t last = first + edges.buckets_per_part;
+        for (uint32_t b = first; b < last; b++) {
+            header.nedges += edges.buckets[b].size();
+        }
+        if (part == 0) {
+            uint64_t edges_end = header.edges_offset + header.nedges * sizeof(image_edge<W>);
+            header.degrees_offset = (edges_end + IMAGE_HEADER_SIZE - 1) / IMAGE_HEADER_SIZE * IMAGE_HEADER_SIZE;
+        }
+
+        image_writer writer;
+        if (!writer.open(image_part_path(output, part), header)) {
+            return false;
+        }
+        for (uint32_t b = first; b < last; b++) {
+            if (!writer.write(edges.buckets[b].data(), edges.buckets[b].size() * sizeof(image_edge<W>))) {
+                return false;
+            }
+        }
+        if (part == 0 && (!writer.align() || !writer.write(degrees.data(), degrees.size() * sizeof(int32_t)))) {
+            return false;
+        }
+        if (!writer.close()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename W>
+static int convert(const char *vertex_file, const char *edge_file, const char *output, const convert_options& opts) {
+    vector<int64_t> old_ids;
+    if (!read_vertices(vertex_file, old_ids)) {
+        return EXIT_FAILURE;
+    }
+    int64_t nvertices = old_ids.size();
+
+    vertex_id_map ids(nvertices);
+    bool unique_ids = true;
+    #pragma omp parallel for reduction(&&:unique_ids)
+    for (int64_t i = 0; i < nvertices; i++) {
+        unique_ids = ids.insert(old_ids[i], i + 1) && unique_ids;
+    }
+    if (!unique_ids) {
+        cerr << "duplicate vertex ids found in " << vertex_file << endl;
+        return EXIT_FAILURE;
+    }
+
+    edge_buckets<W> edges(opts.nparts, nvertices);
+    if (!read_edges(edge_file, ids, opts, edges)) {
+        return EXIT_FAILURE;
+    }
+
+    if (opts.reorder != REORDER_NONE) {
+        reorder_vertices(opts.reorder, old_ids, edges);
+    }
+
+    if (!opts.duplicated_edges) {
+        #pragma omp parallel for schedule(dynamic)
+        for (uint32_t b = 0; b < edges.nbuckets; b++) {
+            vector<image_edge<W> >& bucket = edges.buckets[b];
+            sort(bucket.begin(), bucket.end(), edge_less<W>);
+            bucket.erase(unique(bucket.begin(), bucket.end(), edge_equal<W>), bucket.end());
+        }
+    }
+
+    vector<int32_t> degrees = count_degrees(nvertices, edges);
+
+    if (!write_image(output, nvertices, opts, edges, degrees)
+            || !write_vertex_translation(vertex_translation_path(output), old_ids)
+            || !write_vertex_index(vertex_index_path(output), old_ids)) {
+        return EXIT_FAILURE;
+    }
+
+    cout << "converted " << nvertices << " vertices and " << edges.nedges() << " edges into "
+         << opts.nparts << " part(s)" << endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    MPI_Init(&argc, &argv);
+
+    convert_options opts;
+    vector<char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            if (!parse_option(argv[i], opts)) {
+                cerr << "unknown option: " << argv[i] << endl;
+                MPI_Finalize();
+                return EXIT_FAILURE;
+            }
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.size() != 3 || opts.nparts < 1) {
+        cerr << "usage: " << argv[0] << " [--selfloops=0|1] [--duplicatededges=0|1] [--bidirectional]"
+             << " [--edgeweights=0|1] [--edgeweighttype=0|1|2] [--parts=N] [--reorder=none|degree|rcm|community]"
+             << " <vertex file> <edge file> <output prefix>" << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    // The converter runs through the same launcher as the benchmark binaries;
+    // only the first rank does the work.
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int result = EXIT_SUCCESS;
+    if (rank == 0) {
+        cout << "num. threads: " << omp_get_max_threads() << endl;
+        // Edge weight types: 0 is int32, 1 is double and 2 is float.
+        if (opts.edge_weights && opts.edge_weight_type == 1) {
+            result = convert<double>(files[0], files[1], files[2], opts);
+        } else if (opts.edge_weights && opts.edge_weight_type == 2) {
+            result = convert<float>(files[0], files[1], files[2], opts);
+        } else {
+            result = convert<int32_t>(files[0], files[1], files[2], opts);
+        }
+    }
+
+    MPI_Bcast(&result, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return result;
+}
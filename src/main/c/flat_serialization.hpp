@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FLAT_SERIALIZATION_HPP
+#define FLAT_SERIALIZATION_HPP
+
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "boost/serialization/binary_object.hpp"
+#include "boost/serialization/vector.hpp"
+
+/*
+ * Serialization of the vectors in messages and vertex values. GraphMat
+ * serializes Serializable types with boost archives, which go through a
+ * vector element by element unless the elements are arithmetic. A vector of
+ * elements that can be copied as bytes is instead written as its length and
+ * one block of raw bytes, and read back by copying that block straight into
+ * the resized vector. Vectors of other elements are serialized by boost.
+ *
+ * Use it from a serialize member as serialize_flat(ar, v) in place of
+ * ar & v. The two layouts differ, so both sides must use the same one.
+ */
+template <typename T>
+struct is_flat_serializable : std::integral_constant<bool, std::is_trivially_copyable<T>::value> { };
+
+// Pairs are not trivially copyable, as they assign their members, but their
+// bytes are all there is to them.
+template <typename A, typename B>
+struct is_flat_serializable<std::pair<A, B> >
+    : std::integral_constant<bool, is_flat_serializable<A>::value && is_flat_serializable<B>::value> { };
+
+template <typename T, bool flat = is_flat_serializable<T>::value>
+struct flat_vector {
+    template <class Archive>
+    static void serialize(Archive &ar, std::vector<T>& v) {
+        ar & v;
+    }
+};
+
+template <typename T>
+struct flat_vector<T, true> {
+    template <class Archive>
+    static void serialize(Archive &ar, std::vector<T>& v) {
+        uint64_t size = v.size();
+        ar & size;
+        if (Archive::is_loading::value) {
+            v.resize(size);
+        }
+        if (size > 0) {
+            boost::serialization::binary_object bytes(v.data(), size * sizeof(T));
+            ar & bytes;
+        }
+    }
+};
+
+template <class Archive, typename T>
+inline void serialize_flat(Archive &ar, std::vector<T>& v) {
+    flat_vector<T>::serialize(ar, v);
+}
+
+#endif
@@ -0,0 +1,510 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GRAPH_IMAGE_HPP
+#define GRAPH_IMAGE_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Graph images are the on-disk format produced by the converter. Every part of
+ * an image is a single file "<prefix><part>" holding a page-sized header and
+ * the raw edge array of that part, stored with the same layout as GraphMat's
+ * edge_t<E>. Loading an image therefore only maps the file and hands the edge
+ * array to the engine: there is no parsing step, and repeated runs on the same
+ * graph are served from the page cache.
+ *
+ * Part 0 also stores the out-degree and in-degree of every vertex, as two
+ * page-aligned int32 arrays indexed by vertex id - 1, so that programs can
+ * look degrees up instead of counting them in supersteps of their own.
+ */
+
+static const char IMAGE_MAGIC[8] = { 'G', 'M', 'I', 'M', 'A', 'G', 'E', '\0' };
+static const uint32_t IMAGE_VERSION = 2;
+static const size_t IMAGE_HEADER_SIZE = 4096;
+
+enum image_value_type {
+    IMAGE_INT32 = 0,
+    IMAGE_FLOAT = 1,
+    IMAGE_DOUBLE = 2
+};
+
+template <typename E> struct image_value_type_of;
+template <> struct image_value_type_of<int32_t> { static const uint32_t value = IMAGE_INT32; };
+template <> struct image_value_type_of<float> { static const uint32_t value = IMAGE_FLOAT; };
+template <> struct image_value_type_of<double> { static const uint32_t value = IMAGE_DOUBLE; };
+
+template <typename E>
+struct image_edge {
+    int32_t src;
+    int32_t dst;
+    E val;
+};
+
+inline size_t image_edge_size(uint32_t value_type) {
+    switch (value_type) {
+        case IMAGE_INT32: return sizeof(image_edge<int32_t>);
+        case IMAGE_FLOAT: return sizeof(image_edge<float>);
+        case IMAGE_DOUBLE: return sizeof(image_edge<double>);
+        default: return 0;
+    }
+}
+
+struct image_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t value_type;
+    uint32_t part;
+    uint32_t nparts;
+    int32_t nvertices;
+    uint32_t row_blocks;    // parts form a row_blocks x (nparts / row_blocks) grid
+    int64_t nedges;         // edges stored in this part
+    int64_t total_nedges;   // edges stored over all parts
+    uint64_t edges_offset;  // byte offset of the edge array in this file
+    uint64_t degrees_offset; // byte offset of the degree arrays (part 0 only, else 0)
+};
+
+/*
+ * Assignment of edges to parts. Like GraphMat's 2D partitioning, the adjacency
+ * matrix is cut into a grid of row blocks (sources) and column blocks
+ * (destinations) that is as square as the number of parts allows, and every
+ * block of the grid becomes one part. Converting with one part per rank thus
+ * gives each rank the shard it loads, and the edges of a part only touch the
+ * vertices of one row and one column block.
+ */
+struct image_partition {
+    uint32_t nparts;
+    uint32_t row_blocks;
+    uint32_t col_blocks;
+    int64_t nvertices;
+
+    image_partition(uint32_t n, int64_t nv) : nparts(n), nvertices(nv > 0 ? nv : 1) {
+        row_blocks = 1;
+        for (uint32_t r = 1; (uint64_t) r * r <= nparts; r++) {
+            if (nparts % r == 0) {
+                row_blocks = r;
+            }
+        }
+        col_blocks = nparts / row_blocks;
+    }
+
+    uint32_t row_block_of(int32_t src) const {
+        return (int64_t) (src - 1) * row_blocks / nvertices;
+    }
+
+    uint32_t col_block_of(int32_t dst) const {
+        return (int64_t) (dst - 1) * col_blocks / nvertices;
+    }
+
+    uint32_t part_of(int32_t src, int32_t dst) const {
+        return row_block_of(src) * col_blocks + col_block_of(dst);
+    }
+};
+
+inline std::string image_part_path(const std::string& prefix, uint32_t part) {
+    return prefix + std::to_string(part);
+}
+
+inline std::string vertex_translation_path(const std::string& prefix) {
+    return prefix + ".ids";
+}
+
+inline std::string vertex_index_path(const std::string& prefix) {
+    return prefix + ".ids.index";
+}
+
+/*
+ * Writes one image part: the header page followed by the edge array, which
+ * may be passed in several pieces, and for part 0 the degree arrays.
+ */
+class image_writer {
+    public:
+        image_writer() : file(NULL), offset(0) { }
+
+        ~image_writer() {
+            if (file != NULL) {
+                fclose(file);
+            }
+        }
+
+        bool open(const std::string& filename, const image_header& header) {
+            path = filename;
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) {
+                std::cerr << "failed to open image file " << path << " for writing" << std::endl;
+                return false;
+            }
+
+            char page[IMAGE_HEADER_SIZE];
+            memset(page, 0, sizeof(page));
+            memcpy(page, &header, sizeof(header));
+            return write(page, sizeof(page));
+        }
+
+        bool write(const void *data, size_t bytes) {
+            if (bytes > 0 && fwrite(data, 1, bytes, file) != bytes) {
+                std::cerr << "failed to write image file " << path << std::endl;
+                return false;
+            }
+            offset += bytes;
+            return true;
+        }
+
+        // Pads the file with zeros up to the next multiple of the page size.
+        bool align() {
+            static const char zeros[IMAGE_HEADER_SIZE] = { 0 };
+            return write(zeros, (IMAGE_HEADER_SIZE - offset % IMAGE_HEADER_SIZE) % IMAGE_HEADER_SIZE);
+        }
+
+        bool close() {
+            bool ok = fclose(file) == 0;
+            file = NULL;
+            if (!ok) {
+                std::cerr << "failed to write image file " << path << std::endl;
+            }
+            return ok;
+        }
+
+    private:
+        std::string path;
+        FILE *file;
+        uint64_t offset;
+};
+
+/*
+ * The vertex translation of an image is a flat array of the original ids,
+ * where entry i holds the original id of vertex i + 1.
+ */
+inline bool write_vertex_translation(const std::string& path, const std::vector<int64_t>& old_ids) {
+    FILE *file = fopen(path.c_str(), "wb");
+    bool ok = file != NULL
+           && fwrite(old_ids.data(), sizeof(int64_t), old_ids.size(), file) == old_ids.size();
+    ok = (file != NULL && fclose(file) == 0) && ok;
+
+    if (!ok) {
+        std::cerr << "failed to write vertex translation " << path << std::endl;
+    }
+    return ok;
+}
+
+struct original_id_less {
+    const std::vector<int64_t>& old_ids;
+
+    explicit original_id_less(const std::vector<int64_t>& old_ids) : old_ids(old_ids) { }
+
+    bool operator()(int64_t a, int64_t b) const {
+        return old_ids[a - 1] < old_ids[b - 1];
+    }
+};
+
+/*
+ * The vertex index of an image is the reverse of its translation: the ids of
+ * all vertices ordered by their original id, so that the id of an original
+ * vertex is found by binary search.
+ */
+inline bool write_vertex_index(const std::string& path, const std::vector<int64_t>& old_ids) {
+    std::vector<int64_t> index(old_ids.size());
+    for (size_t i = 0; i < index.size(); i++) {
+        index[i] = i + 1;
+    }
+    std::sort(index.begin(), index.end(), original_id_less(old_ids));
+
+    FILE *file = fopen(path.c_str(), "wb");
+    bool ok = file != NULL
+           && fwrite(index.data(), sizeof(int64_t), index.size(), file) == index.size();
+    ok = (file != NULL && fclose(file) == 0) && ok;
+
+    if (!ok) {
+        std::cerr << "failed to write vertex index " << path << std::endl;
+    }
+    return ok;
+}
+
+/*
+ * Read-only view of one image part. The file is mapped private, so the engine
+ * may reorder the edge array in place without touching the file on disk.
+ */
+class mapped_image {
+    public:
+        mapped_image() : data(NULL), length(0) { }
+
+        ~mapped_image() {
+            close();
+        }
+
+        bool open(const std::string& path) {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t) st.st_size < IMAGE_HEADER_SIZE) {
+                ::close(fd);
+                return false;
+            }
+
+            void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED) {
+                std::cerr << "failed to map image file " << path << std::endl;
+                return false;
+            }
+
+            data = (char*) addr;
+            length = st.st_size;
+
+            const image_header& h = header();
+            if (memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) {
+                close();
+                return false;
+            }
+            if (h.version != IMAGE_VERSION || image_edge_size(h.value_type) == 0
+                    || h.edges_offset + h.nedges * image_edge_size(h.value_type) > length
+                    || h.degrees_offset + (h.degrees_offset != 0 ? 2 * sizeof(int32_t) * h.nvertices : 0) > length) {
+                std::cerr << "image file " << path << " is corrupt or has an unsupported version" << std::endl;
+                close();
+                return false;
+            }
+
+            madvise(data + h.edges_offset, length - h.edges_offset, MADV_SEQUENTIAL);
+            return true;
+        }
+
+        void close() {
+            if (data != NULL) {
+                munmap(data, length);
+                data = NULL;
+                length = 0;
+            }
+        }
+
+        const image_header& header() const {
+            return *(const image_header*) data;
+        }
+
+        char* edges() const {
+            return data + header().edges_offset;
+        }
+
+    private:
+        mapped_image(const mapped_image&);
+        mapped_image& operator=(const mapped_image&);
+
+        char *data;
+        size_t length;
+};
+
+/*
+ * Read-only view of the vertex translation of an image.
+ */
+class vertex_translation {
+    public:
+        vertex_translation() : ids(NULL), nvertices(0) { }
+
+        ~vertex_translation() {
+            close();
+        }
+
+        bool open(const std::string& path) {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+
+            void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED) {
+                std::cerr << "failed to map vertex translation " << path << std::endl;
+                return false;
+            }
+
+            ids = (const int64_t*) addr;
+            nvertices = st.st_size / sizeof(int64_t);
+            return true;
+        }
+
+        void close() {
+            if (ids != NULL) {
+                munmap((void*) ids, nvertices * sizeof(int64_t));
+                ids = NULL;
+                nvertices = 0;
+            }
+        }
+
+        bool is_open() const {
+            return ids != NULL;
+        }
+
+        int64_t original_id(int64_t vertex) const {
+            return ids[vertex - 1];
+        }
+
+    private:
+        vertex_translation(const vertex_translation&);
+        vertex_translation& operator=(const vertex_translation&);
+
+        const int64_t *ids;
+        size_t nvertices;
+};
+
+/*
+ * Read-only view of the degree arrays stored in part 0 of an image.
+ */
+class vertex_degrees {
+    public:
+        vertex_degrees() : data(NULL), length(0), out_degrees(NULL), in_degrees(NULL) { }
+
+        ~vertex_degrees() {
+            close();
+        }
+
+        bool open(const std::string& path) {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+
+            image_header h;
+            if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0
+                    || h.version != IMAGE_VERSION || h.degrees_offset == 0) {
+                ::close(fd);
+                return false;
+            }
+
+            length = 2 * sizeof(int32_t) * h.nvertices;
+            void *addr = length > 0 ? mmap(NULL, length, PROT_READ, MAP_SHARED, fd, h.degrees_offset) : MAP_FAILED;
+            ::close(fd);
+            if (addr == MAP_FAILED) {
+                length = 0;
+                return false;
+            }
+
+            data = (char*) addr;
+            out_degrees = (const int32_t*) data;
+            in_degrees = out_degrees + h.nvertices;
+            return true;
+        }
+
+        void close() {
+            if (data != NULL) {
+                munmap(data, length);
+                data = NULL;
+                length = 0;
+                out_degrees = in_degrees = NULL;
+            }
+        }
+
+        bool is_open() const {
+            return data != NULL;
+        }
+
+        int32_t out_degree(int64_t vertex) const {
+            return out_degrees[vertex - 1];
+        }
+
+        int32_t in_degree(int64_t vertex) const {
+            return in_degrees[vertex - 1];
+        }
+
+    private:
+        vertex_degrees(const vertex_degrees&);
+        vertex_degrees& operator=(const vertex_degrees&);
+
+        char *data;
+        size_t length;
+        const int32_t *out_degrees;
+        const int32_t *in_degrees;
+};
+
+inline bool is_graph_image(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(IMAGE_MAGIC)];
+    bool match = read(fd, magic, sizeof(magic)) == sizeof(magic)
+              && memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0;
+    ::close(fd);
+    return match;
+}
+
+/*
+ * Reads the edge value type of an image part without mapping it. Returns
+ * false if the file is not a graph image.
+ */
+inline bool read_image_value_type(const std::string& path, uint32_t& value_type) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    image_header h;
+    bool match = pread(fd, &h, sizeof(h), 0) == sizeof(h)
+              && memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0;
+    ::close(fd);
+    if (match) value_type = h.value_type;
+    return match;
+}
+
+/*
+ * Copies the edges of a part into an array of edge_t-like records, converting
+ * the stored value type to E.
+ */
+template <typename W, typename T>
+void copy_image_edges(const mapped_image& image, T* out) {
+    const image_edge<W>* in = (const image_edge<W>*) image.edges();
+    int64_t n = image.header().nedges;
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < n; i++) {
+        out[i].src = in[i].src;
+        out[i].dst = in[i].dst;
+        out[i].val = in[i].val;
+    }
+}
+
+template <typename T>
+void copy_image_edges(const mapped_image& image, T* out) {
+    switch (image.header().value_type) {
+        case IMAGE_INT32: copy_image_edges<int32_t>(image, out); break;
+        case IMAGE_FLOAT: copy_image_edges<float>(image, out); break;
+        case IMAGE_DOUBLE: copy_image_edges<double>(image, out); break;
+    }
+}
+
+#endif
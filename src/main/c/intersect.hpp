@@ -0,0 +1,289 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INTERSECT_HPP
+#define INTERSECT_HPP
+
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Intersection of sorted lists of ids without duplicates, as used for
+ * counting triangles.
+ *
+ * Lists of similar size are merged a block at a time: a block of each list
+ * is loaded into a vector register, and every rotation of the block of b is
+ * compared with the block of a, so one pass of W rotations compares all W*W
+ * pairs. The widest instruction set the processor supports (SSE2, AVX2 or
+ * AVX-512) is chosen at run time, so that binaries built for an older
+ * processor still use the wider vectors. When one list is much longer than
+ * the other, each element of the short list is instead searched for in the
+ * long one, galloping ahead from the previous match.
+ */
+namespace intersect {
+
+// Lists whose sizes differ by this factor or more are intersected by
+// galloping through the longer one.
+const int64_t gallop_ratio = 32;
+
+enum simd_level { SIMD_NONE, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+inline simd_level detect_simd_level() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    return SIMD_SSE2;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+inline simd_level current_simd_level() {
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+/*
+ * Passes the matches of the kernels on to f(i, k), for every a[i] == b[k].
+ * A block match means that a[i + j] == b[k + (j + r) % width] for every bit
+ * j of the mask.
+ */
+template <typename F>
+struct position_sink {
+    F& f;
+
+    explicit position_sink(F& f) : f(f) { }
+
+    void operator()(int64_t i, int64_t k) {
+        f(i, k);
+    }
+
+    void block(int64_t i, int64_t k, int r, int width, uint32_t mask) {
+        for (; mask != 0; mask &= mask - 1) {
+            int j = __builtin_ctz(mask);
+            f(i + j, k + ((j + r) & (width - 1)));
+        }
+    }
+};
+
+struct count_sink {
+    int64_t count;
+
+    count_sink() : count(0) { }
+
+    void operator()(int64_t i, int64_t k) {
+        count++;
+    }
+
+    void block(int64_t i, int64_t k, int r, int width, uint32_t mask) {
+        count += __builtin_popcount(mask);
+    }
+};
+
+// Turns the matches of b in a into matches of a in b.
+template <typename S>
+struct swapped_sink {
+    S& sink;
+
+    explicit swapped_sink(S& sink) : sink(sink) { }
+
+    void operator()(int64_t k, int64_t i) {
+        sink(i, k);
+    }
+};
+
+template <typename S>
+inline void merge_scalar(const int32_t *a, int64_t i, int64_t na, const int32_t *b, int64_t k, int64_t nb,
+                         S& sink) {
+    while (i < na && k < nb) {
+        if (a[i] == b[k]) {
+            sink(i, k);
+            i++;
+            k++;
+        } else if (a[i] < b[k]) {
+            i++;
+        } else {
+            k++;
+        }
+    }
+}
+
+/*
+ * Searches every element of the short list a in the long list b, doubling
+ * the step from the previous position until it passes the element, and
+ * then bisecting the last step.
+ */
+template <typename S>
+inline void gallop(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, S& sink) {
+    int64_t k = 0;
+    for (int64_t i = 0; i < na && k < nb; i++) {
+        int32_t x = a[i];
+        if (b[k] < x) {
+            int64_t low = k;
+            int64_t step = 1;
+            while (low + step < nb && b[low + step] < x) {
+                low += step;
+                step *= 2;
+            }
+            // b[low] < x <= b[high], if high is in the list.
+            int64_t high = low + step < nb ? low + step : nb;
+            while (high - low > 1) {
+                int64_t middle = low + (high - low) / 2;
+                if (b[middle] < x) {
+                    low = middle;
+                } else {
+                    high = middle;
+                }
+            }
+            k = high;
+        }
+        if (k < nb && b[k] == x) {
+            sink(i, k);
+            k++;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+
+template <typename S>
+inline void merge_sse2(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, S& sink) {
+    int64_t i = 0, k = 0;
+    while (i + 4 <= na && k + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*) (b + k));
+        __m128i rotations[4] = {
+            vb,
+            _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)),
+            _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)),
+            _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))
+        };
+        for (int r = 0; r < 4; r++) {
+            uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, rotations[r])));
+            if (mask) sink.block(i, k, r, 4, mask);
+        }
+        int32_t a_last = a[i + 3];
+        int32_t b_last = b[k + 3];
+        if (a_last <= b_last) i += 4;
+        if (b_last <= a_last) k += 4;
+    }
+    merge_scalar(a, i, na, b, k, nb, sink);
+}
+
+template <typename S>
+__attribute__((target("avx2")))
+inline void merge_avx2(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, S& sink) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    int64_t i = 0, k = 0;
+    while (i + 8 <= na && k + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*) (b + k));
+        for (int r = 0; r < 8; r++) {
+            __m256i rotation = _mm256_and_si256(_mm256_add_epi32(lanes, _mm256_set1_epi32(r)), last_lane);
+            __m256i equal = _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb, rotation));
+            uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+            if (mask) sink.block(i, k, r, 8, mask);
+        }
+        int32_t a_last = a[i + 7];
+        int32_t b_last = b[k + 7];
+        if (a_last <= b_last) i += 8;
+        if (b_last <= a_last) k += 8;
+    }
+    merge_scalar(a, i, na, b, k, nb, sink);
+}
+
+template <typename S>
+__attribute__((target("avx512f")))
+inline void merge_avx512(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, S& sink) {
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i last_lane = _mm512_set1_epi32(15);
+    int64_t i = 0, k = 0;
+    while (i + 16 <= na && k + 16 <= nb) {
+        __m512i va = _mm512_loadu_si512((const void*) (a + i));
+        __m512i vb = _mm512_loadu_si512((const void*) (b + k));
+        for (int r = 0; r < 16; r++) {
+            __m512i rotation = _mm512_and_si512(_mm512_add_epi32(lanes, _mm512_set1_epi32(r)), last_lane);
+            uint32_t mask = _mm512_cmpeq_epi32_mask(va, _mm512_permutexvar_epi32(rotation, vb));
+            if (mask) sink.block(i, k, r, 16, mask);
+        }
+        int32_t a_last = a[i + 15];
+        int32_t b_last = b[k + 15];
+        if (a_last <= b_last) i += 16;
+        if (b_last <= a_last) k += 16;
+    }
+    merge_scalar(a, i, na, b, k, nb, sink);
+}
+
+#endif
+
+template <typename S>
+inline void intersect(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, S& sink) {
+    if (na == 0 || nb == 0 || a[0] > b[nb - 1] || b[0] > a[na - 1]) {
+        return;
+    }
+    if (nb >= gallop_ratio * na) {
+        gallop(a, na, b, nb, sink);
+        return;
+    }
+    if (na >= gallop_ratio * nb) {
+        swapped_sink<S> swapped(sink);
+        gallop(b, nb, a, na, swapped);
+        return;
+    }
+    switch (current_simd_level()) {
+#if defined(__x86_64__)
+        case SIMD_AVX512:
+            merge_avx512(a, na, b, nb, sink);
+            return;
+        case SIMD_AVX2:
+            merge_avx2(a, na, b, nb, sink);
+            return;
+        case SIMD_SSE2:
+            merge_sse2(a, na, b, nb, sink);
+            return;
+#endif
+        default:
+            merge_scalar(a, 0, na, b, 0, nb, sink);
+    }
+}
+
+/*
+ * Calls f(i, k) for every a[i] == b[k] of two sorted lists without
+ * duplicates, in no particular order.
+ */
+template <typename F>
+inline void for_each_common(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, F& f) {
+    position_sink<F> sink(f);
+    intersect(a, na, b, nb, sink);
+}
+
+/*
+ * Returns the number of ids two sorted lists without duplicates have in
+ * common.
+ */
+inline int64_t count_common(const int32_t *a, int64_t na, const int32_t *b, int64_t nb) {
+    count_sink sink;
+    intersect(a, na, b, nb, sink);
+    return sink.count;
+}
+
+}
+
+#endif
@@ -0,0 +1,819 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef LCC_HPP
+#define LCC_HPP
+
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <iostream>
+#include "boost/serialization/vector.hpp"
+#include "boost/serialization/utility.hpp"
+
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+#include "flat_serialization.hpp"
+#include "intersect.hpp"
+
+namespace lcc {
+
+using namespace std;
+
+
+struct vertex_value_type : public GraphMat::Serializable {
+  public:
+    int id;
+    std::vector<int> all_neighbors;
+    std::vector<int> out_neighbors;
+    double clustering_coef;
+  public:
+    vertex_value_type() {
+      id = -1;
+      all_neighbors.clear();
+      out_neighbors.clear();
+      clustering_coef = 0.0;
+    }
+
+    vertex_value_type(double coef) {
+	clustering_coef = coef;
+    }
+    bool operator!=(const vertex_value_type& t) const {
+      return (true); //dummy
+    }
+    ~vertex_value_type() {
+      all_neighbors.clear();
+      out_neighbors.clear();
+    }
+    friend ostream& operator<<(ostream& stream, const vertex_value_type &v) {
+            stream << v.clustering_coef;
+            return stream;
+        }
+
+    double get_output() {
+            return clustering_coef;
+        }
+    friend boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+	ar & id;
+	serialize_flat(ar, all_neighbors);
+	serialize_flat(ar, out_neighbors);
+	ar & clustering_coef;
+    }
+
+};
+
+template<typename T>
+class serializable_vector : public GraphMat::Serializable {
+  public:
+    std::vector<T> v;
+  public:
+    friend boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+      serialize_flat(ar, v);
+    }
+};
+typedef serializable_vector<int> collect_reduce_type;
+typedef int collect_msg_type;
+
+
+class CollectNeighborsOutProgram: public GraphMat::GraphProgram<collect_msg_type, collect_reduce_type, vertex_value_type> {
+
+  public:
+      bool isDirected;
+
+
+  CollectNeighborsOutProgram(int maxvertices, bool _isDirected) {
+    isDirected = _isDirected;
+    order = GraphMat::IN_EDGES;
+    activity = GraphMat::ALL_VERTICES;
+    process_message_requires_vertexprop = false;
+  }
+
+  void reduce_function(collect_reduce_type& a, const collect_reduce_type& b) const {
+    a.v.insert(a.v.end(), b.v.begin(), b.v.end()); 
+  }
+
+  void process_message(const collect_msg_type& message, const int edge_val, const vertex_value_type& vertexprop, collect_reduce_type& res) const {
+    res.v.clear(); 
+    res.v.push_back(message);
+  }
+  bool send_message(const vertex_value_type& vertexprop, collect_msg_type& message) const {
+    message = vertexprop.id;
+    return true;
+  }
+  void apply(const collect_reduce_type& message_out, vertex_value_type& vertexprop) {
+    // The intersections expect neighbor lists without duplicates.
+    auto& all_neighbors = vertexprop.all_neighbors;
+    all_neighbors = message_out.v;
+    std::sort(all_neighbors.begin(), all_neighbors.end());
+    all_neighbors.erase(unique(all_neighbors.begin(), all_neighbors.end()), all_neighbors.end());
+    if (isDirected) {
+      vertexprop.out_neighbors = all_neighbors;
+    }
+  }
+
+};
+class CollectNeighborsInProgram: public GraphMat::GraphProgram<collect_msg_type, collect_reduce_type, vertex_value_type> {
+
+  public:
+
+
+  CollectNeighborsInProgram(int maxvertices) {
+    order = GraphMat::OUT_EDGES;
+    activity = GraphMat::ALL_VERTICES;
+    process_message_requires_vertexprop = false;
+  }
+
+  void reduce_function(collect_reduce_type& a, const collect_reduce_type& b) const {
+    a.v.insert(a.v.end(), b.v.begin(), b.v.end()); 
+  }
+
+  void process_message(const collect_msg_type& message, const int edge_val, const vertex_value_type& vertexprop, collect_reduce_type& res) const {
+    res.v.clear(); 
+    res.v.push_back(message);
+  }
+  bool send_message(const vertex_value_type& vertexprop, collect_msg_type& message) const {
+    message = vertexprop.id;
+    return true;
+  }
+  void apply(const collect_reduce_type& message_out, vertex_value_type& vertexprop) {
+    auto& all_neighbors = vertexprop.all_neighbors;
+    all_neighbors.insert(all_neighbors.end(), message_out.v.begin(), message_out.v.end());
+
+    std::sort(all_neighbors.begin(), all_neighbors.end());
+    auto last = unique(all_neighbors.begin(), all_neighbors.end());
+    all_neighbors.erase(last, all_neighbors.end());
+
+  }
+
+};
+
+class count_msg_type : public GraphMat::Serializable {
+  public:
+    std::vector<int> v;
+    int id;
+
+    friend boost::serialization::access;
+    template<class Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+      ar & id;
+      serialize_flat(ar, v);
+    }
+};
+typedef serializable_vector<pair< int, int> > count_reduce_type;
+
+class CountTrianglesProgram: public GraphMat::GraphProgram<count_msg_type, count_reduce_type, vertex_value_type> {
+
+  public:
+
+  CountTrianglesProgram() {
+    order = GraphMat::ALL_EDGES;
+    activity = GraphMat::ALL_VERTICES;
+  }
+
+  void reduce_function(count_reduce_type& a, const count_reduce_type& b) const {
+    a.v.insert(a.v.end(), b.v.begin(), b.v.end()); 
+  }
+
+  void process_message(const count_msg_type& message, const int edge_val, const vertex_value_type& vertexprop, count_reduce_type& res) const {
+    int tri = intersect::count_common(message.v.data(), message.v.size(),
+                                      vertexprop.all_neighbors.data(), vertexprop.all_neighbors.size());
+
+    int id = message.id;
+    auto x = make_pair(id, tri);
+    res.v.clear(); 
+    res.v.push_back(x); 
+
+    return;
+  }
+
+  bool send_message(const vertex_value_type& vertex, count_msg_type& message) const {
+    message.v = vertex.out_neighbors;
+    message.id = vertex.id;
+    return true;
+  }
+
+  void apply(const count_reduce_type& message_out, vertex_value_type& vertexprop) {
+    auto v = message_out.v;
+    std::sort(v.begin(), v.end());
+    auto last = unique(v.begin(), v.end());
+    
+    int sum_of_elems = 0;
+    std::for_each(v.begin(), last, [&] (pair<int, int> n) {
+      sum_of_elems += n.second;
+    });
+    int deg = vertexprop.all_neighbors.size();
+    vertexprop.clustering_coef = (deg > 1)?((double)(sum_of_elems)/(double)(deg)/(double)(deg-1)):(0.0);
+  }
+
+};
+
+typedef int count_reduce_undirected_type;
+typedef serializable_vector<int> count_msg_undirected_type;
+class CountTrianglesUndirectedProgram: public GraphMat::GraphProgram<count_msg_undirected_type, count_reduce_undirected_type, vertex_value_type> {
+
+  public:
+
+  CountTrianglesUndirectedProgram() {
+    order = GraphMat::OUT_EDGES;
+    activity = GraphMat::ALL_VERTICES;
+  }
+
+  void reduce_function(count_reduce_undirected_type& a, const count_reduce_undirected_type& b) const {
+    a += b;
+  }
+
+  void process_message(const count_msg_undirected_type& message, const int edge_val, const vertex_value_type& vertexprop, count_reduce_undirected_type& res) const {
+    count_reduce_undirected_type tri = intersect::count_common(message.v.data(), message.v.size(),
+                                                               vertexprop.all_neighbors.data(),
+                                                               vertexprop.all_neighbors.size());
+
+    res = tri;
+
+    return;
+  }
+
+  bool send_message(const vertex_value_type& vertex, count_msg_undirected_type& message) const {
+    message.v = vertex.all_neighbors;
+    return true;
+  }
+
+  void apply(const count_reduce_undirected_type& message_out, vertex_value_type& vertexprop) {
+    int deg = vertexprop.all_neighbors.size();
+    vertexprop.clustering_coef = (deg > 1)?((double)(message_out)/(double)(deg)/(double)(deg-1)):(0.0);
+  }
+
+};
+
+void initialize(GraphMat::Graph<vertex_value_type, int>& graph) {
+    for (size_t i = 1; i <= graph.getNumberOfVertices(); i++) {
+	if (graph.vertexNodeOwner(i)) {
+        	vertex_value_type v;
+        	v.id = i;
+        	graph.setVertexproperty(i, v);
+	}
+    }
+}
+
+/*
+ * LCC in the engine: every vertex collects its neighbor lists, and then
+ * intersects them with the list sent along every edge.
+ */
+inline void count_triangles_in_engine(GraphMat::Graph<vertex_value_type, int>& graph, int isDirected) {
+    CollectNeighborsOutProgram col_prog_out(graph.nvertices, isDirected);
+    CollectNeighborsInProgram col_prog_in(graph.nvertices);
+    CountTrianglesProgram cnt_prog;
+    CountTrianglesUndirectedProgram cnt_undir_prog;
+
+    auto col_ctx_out = GraphMat::graph_program_init(col_prog_out, graph);
+    auto col_ctx_in = GraphMat::graph_program_init(col_prog_in, graph);
+    auto cnt_ctx = GraphMat::graph_program_init(cnt_prog, graph);
+    auto cnt_undir_ctx = GraphMat::graph_program_init(cnt_undir_prog, graph);
+
+    timer_next("run algorithm 1 - phase 1 & 2 (collect neighbors)");
+    GraphMat::run_graph_program(&col_prog_out, graph, 1, &col_ctx_out);
+    if (isDirected) GraphMat::run_graph_program(&col_prog_in, graph, 1, &col_ctx_in);
+
+    timer_next("run algorithm 2 (count triangles)");
+    if (isDirected) {
+        GraphMat::run_graph_program(&cnt_prog, graph, 1, &cnt_ctx);
+    } else {
+        GraphMat::run_graph_program(&cnt_undir_prog, graph, 1, &cnt_undir_ctx);
+    }
+
+    GraphMat::graph_program_clear(col_ctx_out);
+    GraphMat::graph_program_clear(col_ctx_in);
+    GraphMat::graph_program_clear(cnt_ctx);
+    GraphMat::graph_program_clear(cnt_undir_ctx);
+}
+
+/*
+ * LCC by counting every triangle once, on read-only adjacency structures
+ * shared by all threads instead of neighbor lists copied into the vertices
+ * and the messages. Rank r counts the triangles of vertices r + 1,
+ * r + 1 + nranks, ..., and holds the neighborhoods of these vertices only:
+ * every rank sends each edge of its image parts to the ranks of its two
+ * endpoints, which build the neighborhoods (in- and out-neighbors, without
+ * duplicates or self loops) in which every neighbor carries a mask of the
+ * directions the two vertices are connected in. Each edge of the
+ * neighborhoods is then oriented from the lower to the higher ranked
+ * endpoint, by degree and then id, so that no vertex keeps more than
+ * O(sqrt(E)) of its neighbors.
+ *
+ * A triangle u, w, x is found once, as a common higher ranked neighbor x of
+ * u and w. Each of its corners counts the directed edges between the other
+ * two, so a vertex ends up with the number of directed edges between its
+ * neighbors, which in an undirected graph (stored in both directions) is
+ * twice its number of triangles. The lists of the neighbors w held by other
+ * ranks are fetched from them for a batch of vertices u at a time, and the
+ * ranks add up their counts at the end.
+ *
+ * On power-law graphs even the oriented lists of hubs grow long, and every
+ * edge between two of them would merge both lists. The lists of hubs are
+ * therefore indexed, so that an intersection with a hub looks up the
+ * elements of the other list only.
+ */
+class triangle_counter {
+    public:
+        triangle_counter() : nvertices(0) { }
+
+        bool is_open() const {
+            return nvertices > 0;
+        }
+
+        bool open(const char *filename) {
+            if (!is_graph_image(image_part_path(filename, 0))) {
+                return false;
+            }
+            graph_image_parts image;
+            image.open(filename);
+            return open(image);
+        }
+
+        bool open(const graph_image_parts& image) {
+            vector<uint64_t> entries;
+            exchange_edges(image, entries);
+            build(image.nvertices, entries);
+            local.index_hubs();
+            nvertices = image.nvertices;
+            return true;
+        }
+
+        /*
+         * Sets the clustering coefficient of the vertices this rank owns.
+         * Without a graph image, LCC runs in the engine.
+         */
+        void run(GraphMat::Graph<vertex_value_type, int>& graph, int isDirected) {
+            if (!is_open()) {
+                count_triangles_in_engine(graph, isDirected);
+                return;
+            }
+
+            timer_next("run algorithm (count triangles)");
+            int rank = GraphMat::get_global_myrank();
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+            vector<int64_t> counts(nvertices + 1, 0);
+            int64_t nlocal = local.offsets.size() - 1;
+            int64_t batch_begin = 0;
+            for (;;) {
+                // Take vertices up to batch_edges higher ranked neighbors.
+                int64_t batch_end = batch_begin;
+                int64_t nedges = 0;
+                while (batch_end < nlocal && (batch_end == batch_begin || nedges < batch_edges)) {
+                    nedges += local.size(batch_end);
+                    batch_end++;
+                }
+                int more = batch_end > batch_begin;
+                MPI_Allreduce(MPI_IN_PLACE, &more, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+                if (!more) break;
+
+                neighborhoods remote;
+                vector<int32_t> remote_ids;
+                vector<int64_t> remote_offsets;
+                fetch_lists(batch_begin, batch_end, remote, remote_ids, remote_offsets);
+
+                #pragma omp parallel for schedule(dynamic, 64)
+                for (int64_t l = batch_begin; l < batch_end; l++) {
+                    int32_t u = l * nranks + rank + 1;
+                    corner_counter corners(local, l, counts);
+                    for (int64_t j = local.offsets[l]; j < local.offsets[l + 1]; j++) {
+                        int32_t w = local.neighbors[j];
+                        int owner = (w - 1) % nranks;
+                        if (owner == rank) {
+                            corners.set_edge(local, (w - 1) / nranks, w, local.directions[j]);
+                        } else {
+                            const int32_t *ids = remote_ids.data();
+                            int64_t i = lower_bound(ids + remote_offsets[owner], ids + remote_offsets[owner + 1], w) - ids;
+                            corners.set_edge(remote, i, w, local.directions[j]);
+                        }
+                        for_each_common(local, l, *corners.w_lists, corners.w_index, corners);
+                    }
+                    #pragma omp atomic
+                    counts[u] += corners.count_u;
+                }
+                batch_begin = batch_end;
+            }
+            MPI_Allreduce(MPI_IN_PLACE, counts.data(), counts.size(), MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+            for (int v = 1; v <= nvertices; v++) {
+                if (graph.vertexNodeOwner(v)) {
+                    vertex_value_type value = graph.getVertexproperty(v);
+                    double d = degrees[v];
+                    value.clustering_coef = degrees[v] > 1 ? counts[v] / d / (d - 1) : 0.0;
+                    graph.setVertexproperty(v, value);
+                }
+            }
+        }
+
+    private:
+        static const int OUT = 1;
+        static const int IN = 2;
+        static const int64_t hub_degree = 1024;
+        // Higher ranked neighbors of the vertices of a batch, which bounds
+        // the lists fetched from other ranks at a time.
+        static const int64_t batch_edges = 1 << 22;
+
+        /*
+         * Higher ranked neighbors of a set of vertices, sorted by id, with
+         * their direction masks. The lists of hubs are indexed by an
+         * open-addressing table from neighbor to position + 1 in the list,
+         * 0 for an empty slot, kept at most half full.
+         */
+        struct neighborhoods {
+            vector<int64_t> offsets;
+            vector<int32_t> neighbors;
+            vector<uint8_t> directions;
+            vector<int64_t> hub_offsets;
+            vector<int32_t> hub_slots;
+
+            int64_t size(int64_t i) const {
+                return offsets[i + 1] - offsets[i];
+            }
+
+            bool is_hub(int64_t i) const {
+                return hub_offsets[i + 1] > hub_offsets[i];
+            }
+
+            // Returns the position of x in the list of hub i, or -1.
+            int64_t find(int64_t i, int32_t x) const {
+                const int32_t *index = &hub_slots[hub_offsets[i]];
+                size_t mask = hub_offsets[i + 1] - hub_offsets[i] - 1;
+                for (size_t slot = hash(x) & mask; index[slot] != 0; slot = (slot + 1) & mask) {
+                    if (neighbors[offsets[i] + index[slot] - 1] == x) {
+                        return index[slot] - 1;
+                    }
+                }
+                return -1;
+            }
+
+            // Indexes the lists of at least hub_degree neighbors.
+            void index_hubs() {
+                int64_t n = offsets.size() - 1;
+                hub_offsets.assign(n + 1, 0);
+                for (int64_t i = 0; i < n; i++) {
+                    int64_t slots = 0;
+                    if (size(i) >= hub_degree) {
+                        slots = 64;
+                        while (slots < 2 * size(i)) slots *= 2;
+                    }
+                    hub_offsets[i + 1] = hub_offsets[i] + slots;
+                }
+                hub_slots.assign(hub_offsets[n], 0);
+                #pragma omp parallel for schedule(dynamic, 1024)
+                for (int64_t i = 0; i < n; i++) {
+                    if (!is_hub(i)) continue;
+                    int32_t *index = &hub_slots[hub_offsets[i]];
+                    size_t mask = hub_offsets[i + 1] - hub_offsets[i] - 1;
+                    for (int64_t k = 0; k < size(i); k++) {
+                        size_t slot = hash(neighbors[offsets[i] + k]) & mask;
+                        while (index[slot] != 0) slot = (slot + 1) & mask;
+                        index[slot] = k + 1;
+                    }
+                }
+            }
+        };
+
+        int nvertices;
+        // Number of distinct neighbors of every vertex.
+        vector<int32_t> degrees;
+        // Lists of the vertices this rank counts, by (v - 1) / nranks.
+        neighborhoods local;
+
+        static size_t hash(int32_t id) {
+            return (uint32_t) id * 2654435761u;
+        }
+
+        /*
+         * Calls f(i, k) for every common neighbor in list a of as and list b
+         * of bs, at i and k in these lists. Against a hub, the elements of
+         * the shorter list are looked up in the index of the hub; other
+         * lists are merged.
+         */
+        template <typename F>
+        static void for_each_common(const neighborhoods& as, int64_t a, const neighborhoods& bs, int64_t b, F& f) {
+            int64_t na = as.size(a);
+            int64_t nb = bs.size(b);
+            const int32_t *la = as.neighbors.data() + as.offsets[a];
+            const int32_t *lb = bs.neighbors.data() + bs.offsets[b];
+            if (na >= nb && as.is_hub(a)) {
+                for (int64_t k = 0; k < nb; k++) {
+                    int64_t i = as.find(a, lb[k]);
+                    if (i >= 0) f(i, k);
+                }
+            } else if (nb > na && bs.is_hub(b)) {
+                for (int64_t i = 0; i < na; i++) {
+                    int64_t k = bs.find(b, la[i]);
+                    if (k >= 0) f(i, k);
+                }
+            } else {
+                intersect::for_each_common(la, na, lb, nb, f);
+            }
+        }
+
+        static int edge_count(uint8_t mask) {
+            return (mask & 1) + (mask >> 1);
+        }
+
+        /*
+         * Adds the directed edges of the triangles u, w, x to the counts of
+         * their corners, keeping the count of u local.
+         */
+        struct corner_counter {
+            const neighborhoods& u_lists;
+            int64_t u_begin;
+            vector<int64_t>& counts;
+            const neighborhoods *w_lists;
+            int64_t w_index;
+            int64_t w_begin;
+            int32_t w;
+            uint8_t uw_mask;
+            int64_t count_u;
+
+            corner_counter(const neighborhoods& u_lists, int64_t u_index, vector<int64_t>& counts)
+                : u_lists(u_lists), u_begin(u_lists.offsets[u_index]), counts(counts), w_lists(NULL), w_index(0),
+                  w_begin(0), w(0), uw_mask(0), count_u(0) { }
+
+            void set_edge(const neighborhoods& lists, int64_t index, int32_t neighbor, uint8_t mask) {
+                w_lists = &lists;
+                w_index = index;
+                w_begin = lists.offsets[index];
+                w = neighbor;
+                uw_mask = mask;
+            }
+
+            void operator()(int64_t i, int64_t k) {
+                int32_t x = u_lists.neighbors[u_begin + i];
+                count_u += edge_count(w_lists->directions[w_begin + k]);
+                #pragma omp atomic
+                counts[w] += edge_count(u_lists.directions[u_begin + i]);
+                #pragma omp atomic
+                counts[x] += edge_count(uw_mask);
+            }
+        };
+
+        /*
+         * Sends every rank r the elements send[send_offsets[r]] up to
+         * send[send_offsets[r + 1]], and receives what the ranks send to
+         * this one, grouped by sender in the same way.
+         */
+        template <typename T>
+        static void exchange(const vector<T>& send, const vector<int64_t>& send_offsets, MPI_Datatype type,
+                             vector<T>& received, vector<int64_t>& received_offsets) {
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+            vector<long long> send_counts(nranks), received_counts(nranks);
+            for (int r = 0; r < nranks; r++) {
+                send_counts[r] = send_offsets[r + 1] - send_offsets[r];
+            }
+            MPI_Alltoall(send_counts.data(), 1, MPI_LONG_LONG, received_counts.data(), 1, MPI_LONG_LONG,
+                         MPI_COMM_WORLD);
+
+            received_offsets.assign(nranks + 1, 0);
+            for (int r = 0; r < nranks; r++) {
+                received_offsets[r + 1] = received_offsets[r] + received_counts[r];
+            }
+            // MPI counts and displacements are ints.
+            if (send_offsets[nranks] > INT_MAX || received_offsets[nranks] > INT_MAX) {
+                std::cerr << "graph is too large to count triangles on this number of ranks" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            vector<int> scounts(nranks), sdispls(nranks), rcounts(nranks), rdispls(nranks);
+            for (int r = 0; r < nranks; r++) {
+                scounts[r] = send_counts[r];
+                sdispls[r] = send_offsets[r];
+                rcounts[r] = received_counts[r];
+                rdispls[r] = received_offsets[r];
+            }
+            received.resize(received_offsets[nranks]);
+            MPI_Alltoallv((void*) send.data(), scounts.data(), sdispls.data(), type,
+                          received.data(), rcounts.data(), rdispls.data(), type, MPI_COMM_WORLD);
+        }
+
+        /*
+         * Sends every edge u -> w of the image parts of this rank, but self
+         * loops, to the ranks of u and w, as the entries u << 33 | w << 2 |
+         * OUT and w << 33 | u << 2 | IN, so that sorting groups the entries
+         * of a neighborhood and of a neighbor. Returns the entries of the
+         * vertices of this rank.
+         */
+        static void exchange_edges(const graph_image_parts& image, vector<uint64_t>& entries) {
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+            vector<int64_t> offsets(nranks + 1, 0);
+            for (int pass = 0; pass < 2; pass++) {
+                vector<uint64_t> send(pass == 0 ? 0 : offsets[nranks]);
+                vector<int64_t> next(offsets);
+                for (size_t p = 0; p < image.parts.size(); p++) {
+                    const char *records = image.parts[p].edges();
+                    size_t stride = image_edge_size(image.parts[p].header().value_type);
+                    int64_t n = image.parts[p].header().nedges;
+                    for (int64_t i = 0; i < n; i++) {
+                        const int32_t *edge = (const int32_t*) (records + i * stride);
+                        uint64_t u = edge[0];
+                        uint64_t w = edge[1];
+                        if (u == w) continue;
+                        if (pass == 0) {
+                            offsets[(u - 1) % nranks + 1]++;
+                            offsets[(w - 1) % nranks + 1]++;
+                        } else {
+                            send[next[(u - 1) % nranks]++] = u << 33 | w << 2 | OUT;
+                            send[next[(w - 1) % nranks]++] = w << 33 | u << 2 | IN;
+                        }
+                    }
+                }
+                if (pass == 0) {
+                    for (int r = 0; r < nranks; r++) offsets[r + 1] += offsets[r];
+                } else {
+                    vector<int64_t> received_offsets;
+                    exchange(send, offsets, MPI_UINT64_T, entries, received_offsets);
+                }
+            }
+        }
+
+        /*
+         * Builds the neighborhoods of the vertices of this rank from their
+         * entries, and keeps the higher ranked neighbors of every vertex.
+         */
+        void build(int n, vector<uint64_t>& entries) {
+            int rank = GraphMat::get_global_myrank();
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+            int64_t nlocal = n > rank ? (n - rank - 1) / nranks + 1 : 0;
+
+            // Group the entries by vertex.
+            vector<int64_t> begin(nlocal + 1, 0);
+            #pragma omp parallel for
+            for (int64_t e = 0; e < (int64_t) entries.size(); e++) {
+                #pragma omp atomic
+                begin[((entries[e] >> 33) - 1) / nranks + 1]++;
+            }
+            for (int64_t l = 0; l < nlocal; l++) {
+                begin[l + 1] += begin[l];
+            }
+            {
+                vector<int64_t> next(begin.begin(), begin.end() - 1);
+                vector<uint64_t> grouped(entries.size());
+                #pragma omp parallel for
+                for (int64_t e = 0; e < (int64_t) entries.size(); e++) {
+                    int64_t l = ((entries[e] >> 33) - 1) / nranks;
+                    grouped[__sync_fetch_and_add(&next[l], 1)] = entries[e];
+                }
+                entries.swap(grouped);
+            }
+
+            // Merge the entries of a neighbor and count the distinct ones.
+            degrees.assign(n + 1, 0);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int64_t l = 0; l < nlocal; l++) {
+                uint64_t *first = entries.data() + begin[l];
+                uint64_t *last = entries.data() + begin[l + 1];
+                sort(first, last);
+                uint64_t *out = first;
+                for (uint64_t *p = first; p != last; p++) {
+                    if (out != first && (out[-1] >> 2) == (*p >> 2)) {
+                        out[-1] |= *p & 3;
+                    } else {
+                        *out++ = *p;
+                    }
+                }
+                degrees[l * nranks + rank + 1] = out - first;
+            }
+            MPI_Allreduce(MPI_IN_PLACE, degrees.data(), degrees.size(), MPI_INT32_T, MPI_SUM, MPI_COMM_WORLD);
+
+            // Keep the neighbors of higher rank.
+            local.offsets.assign(nlocal + 1, 0);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int64_t l = 0; l < nlocal; l++) {
+                int32_t v = l * nranks + rank + 1;
+                int64_t kept = 0;
+                for (int64_t i = begin[l]; i < begin[l] + degrees[v]; i++) {
+                    if (ranks_higher(neighbor_of(entries[i]), v)) kept++;
+                }
+                local.offsets[l + 1] = kept;
+            }
+            for (int64_t l = 0; l < nlocal; l++) {
+                local.offsets[l + 1] += local.offsets[l];
+            }
+            local.neighbors.resize(local.offsets[nlocal]);
+            local.directions.resize(local.offsets[nlocal]);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int64_t l = 0; l < nlocal; l++) {
+                int32_t v = l * nranks + rank + 1;
+                int64_t out = local.offsets[l];
+                for (int64_t i = begin[l]; i < begin[l] + degrees[v]; i++) {
+                    int32_t w = neighbor_of(entries[i]);
+                    if (ranks_higher(w, v)) {
+                        local.neighbors[out] = w;
+                        local.directions[out] = entries[i] & 3;
+                        out++;
+                    }
+                }
+            }
+        }
+
+        static int32_t neighbor_of(uint64_t entry) {
+            return (entry >> 2) & INT_MAX;
+        }
+
+        /*
+         * Fetches the lists of the neighbors held by other ranks of the
+         * vertices of this rank from batch_begin up to batch_end. The list
+         * of neighbor w from rank r is list remote_ids[i] of remote, for i
+         * from remote_offsets[r] up to remote_offsets[r + 1], where the ids
+         * are sorted.
+         */
+        void fetch_lists(int64_t batch_begin, int64_t batch_end, neighborhoods& remote,
+                         vector<int32_t>& remote_ids, vector<int64_t>& remote_offsets) const {
+            int rank = GraphMat::get_global_myrank();
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+            vector<int32_t> wanted;
+            for (int64_t j = local.offsets[batch_begin]; j < local.offsets[batch_end]; j++) {
+                int32_t w = local.neighbors[j];
+                if ((w - 1) % nranks != rank) wanted.push_back(w);
+            }
+            sort(wanted.begin(), wanted.end());
+            wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+
+            // Group the wanted ids by rank, keeping them sorted.
+            vector<int64_t> wanted_offsets(nranks + 1, 0);
+            for (size_t i = 0; i < wanted.size(); i++) {
+                wanted_offsets[(wanted[i] - 1) % nranks + 1]++;
+            }
+            for (int r = 0; r < nranks; r++) {
+                wanted_offsets[r + 1] += wanted_offsets[r];
+            }
+            remote_ids.resize(wanted.size());
+            vector<int64_t> next(wanted_offsets);
+            for (size_t i = 0; i < wanted.size(); i++) {
+                remote_ids[next[(wanted[i] - 1) % nranks]++] = wanted[i];
+            }
+            remote_offsets = wanted_offsets;
+
+            // Answer the requests of the other ranks with the sizes of the
+            // lists, and then the lists themselves.
+            vector<int32_t> requests;
+            vector<int64_t> request_offsets;
+            exchange(remote_ids, remote_offsets, MPI_INT32_T, requests, request_offsets);
+
+            vector<int64_t> sizes(requests.size());
+            vector<int64_t> starts(requests.size() + 1, 0);
+            for (size_t i = 0; i < requests.size(); i++) {
+                sizes[i] = local.size((requests[i] - 1) / nranks);
+                starts[i + 1] = starts[i] + sizes[i];
+            }
+            vector<int64_t> list_offsets(nranks + 1);
+            for (int r = 0; r <= nranks; r++) {
+                list_offsets[r] = starts[request_offsets[r]];
+            }
+            vector<int32_t> lists(starts[requests.size()]);
+            vector<uint8_t> masks(starts[requests.size()]);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int64_t i = 0; i < (int64_t) requests.size(); i++) {
+                int64_t l = (requests[i] - 1) / nranks;
+                copy(local.neighbors.data() + local.offsets[l], local.neighbors.data() + local.offsets[l + 1],
+                     lists.data() + starts[i]);
+                copy(local.directions.data() + local.offsets[l], local.directions.data() + local.offsets[l + 1],
+                     masks.data() + starts[i]);
+            }
+
+            vector<int64_t> remote_sizes, ignored;
+            exchange(sizes, request_offsets, MPI_INT64_T, remote_sizes, ignored);
+            exchange(lists, list_offsets, MPI_INT32_T, remote.neighbors, ignored);
+            exchange(masks, list_offsets, MPI_UINT8_T, remote.directions, ignored);
+
+            remote.offsets.assign(remote_sizes.size() + 1, 0);
+            for (size_t i = 0; i < remote_sizes.size(); i++) {
+                remote.offsets[i + 1] = remote.offsets[i] + remote_sizes[i];
+            }
+            remote.index_hubs();
+        }
+
+        bool ranks_higher(int32_t w, int32_t v) const {
+            return degrees[w] > degrees[v] || (degrees[w] == degrees[v] && w > v);
+        }
+};
+
+}
+
+#endif
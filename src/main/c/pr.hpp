@@ -0,0 +1,690 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PR_HPP
+#define PR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <vector>
+
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+
+namespace pr {
+
+using namespace std;
+
+typedef double score_type;
+typedef score_type msg_type;
+typedef score_type reduce_type;
+
+struct vertex_value_type {
+    public:
+        score_type score;
+        int out_degree;
+
+        vertex_value_type() {
+            score = 0.0;
+            out_degree = 0;
+        }
+
+        vertex_value_type(score_type score_out) {
+            score = score_out;
+        }
+
+        bool operator!=(const vertex_value_type& other) const {
+            return !(out_degree == other.out_degree && score == other.score);
+        }
+
+        friend ostream& operator<<(ostream& stream, const vertex_value_type &v) {
+            stream << v.score;
+            return stream;
+        }
+
+        score_type get_output() {
+            return score;
+        }
+};
+
+/*
+ * Degree counting for graphs without degree arrays (see load_graph_metadata).
+ * InDegreeProgram briefly stores the in-degree in out_degree, which is only
+ * used to find the vertices without incoming edges.
+ */
+template <typename V>
+class OutDegreeProgram: public GraphMat::GraphProgram<int, int, V> {
+    public:
+        OutDegreeProgram() {
+            this->order = GraphMat::IN_EDGES;
+            this->activity = GraphMat::ALL_VERTICES;
+    	    this->process_message_requires_vertexprop = false;
+        }
+
+        bool send_message(const V& vertex, int& msg) const {
+            msg = 1;
+            return true;
+        }
+
+        void process_message(const int& msg, const int edge, const V& vertex, int& result) const {
+            result = msg;
+        }
+
+        void reduce_function(int& total, const int& partial) const {
+            total += partial;
+        }
+
+        void apply(const int& total, V& vertex) {
+            vertex.out_degree = total;
+        }
+
+};
+
+template <typename V>
+class InDegreeProgram: public GraphMat::GraphProgram<int, int, V> {
+    public:
+        InDegreeProgram() {
+            this->order = GraphMat::OUT_EDGES;
+            this->activity = GraphMat::ALL_VERTICES;
+    	    this->process_message_requires_vertexprop = false;
+        }
+
+        bool send_message(const V& vertex, int& msg) const {
+            msg = 1;
+            return true;
+        }
+
+        void process_message(const int& msg, const int edge, const V& vertex, int& result) const {
+            result = msg;
+        }
+
+        void reduce_function(int& total, const int& partial) const {
+            total += partial;
+        }
+
+        void apply(const int& total, V& vertex) {
+            vertex.out_degree = total;
+        }
+
+};
+
+template <typename V>
+void init_score_and_count_dangling(V* v, int* res, void* param_t) {
+  int N = *(int*)param_t;
+  v->score = 1.0/N;
+  *res = (v->out_degree == 0)?(1):(0);
+}
+
+template <typename T>
+void add(const T& a, const T& b, T *c, void* param_t) {
+  *c = a+b;
+}
+
+template <typename V>
+void dangling_score(V* v, score_type* res, void* param_t) {
+  *res = (v->out_degree == 0)?(v->score):(0);
+}
+
+/*
+ * Sets the out-degree of all vertices and collects the owned vertices without
+ * incoming edges by running the degree programs.
+ */
+template <typename V>
+void count_degrees(GraphMat::Graph<V>& graph, vector<int>& sources) {
+    InDegreeProgram<V> in_deg_prog;
+    auto ctx1 = GraphMat::graph_program_init(in_deg_prog, graph);
+    GraphMat::run_graph_program(&in_deg_prog, graph, 1, &ctx1);
+    GraphMat::graph_program_clear(ctx1);
+
+    for (int i = 1; i <= graph.getNumberOfVertices(); i++) {
+        if (graph.vertexNodeOwner(i) && graph.getVertexproperty(i).out_degree == 0) {
+            sources.push_back(i);
+        }
+    }
+    graph.setAllVertexproperty(V());
+
+    OutDegreeProgram<V> out_deg_prog;
+    auto ctx2 = GraphMat::graph_program_init(out_deg_prog, graph);
+    GraphMat::run_graph_program(&out_deg_prog, graph, 1, &ctx2);
+    GraphMat::graph_program_clear(ctx2);
+}
+
+/*
+ * Fixed-iteration PageRank. The contributions are sent as M, either double
+ * or float, and always added up in double; float halves the messages the
+ * engine exchanges between ranks (see float_messages_are_accurate).
+ */
+template <typename M = msg_type>
+class PageRankProgram: public GraphMat::GraphProgram<M, reduce_type, vertex_value_type> {
+    public:
+        double damping_factor;
+        score_type dangling_sum;
+        GraphMat::Graph<vertex_value_type>& graph;
+
+        PageRankProgram(GraphMat::Graph<vertex_value_type> &g, double df): graph(g), damping_factor(df) {
+            this->order = GraphMat::OUT_EDGES;
+            this->activity = GraphMat::ALL_VERTICES;
+    	    this->process_message_requires_vertexprop = false;
+        }
+
+        // Owned vertices without incoming edges, which receive no messages.
+        vector<int> sources;
+
+        /*
+         * Sets the initial scores. The degrees are looked up in the degree
+         * arrays of the graph image, or counted for graphs without them.
+         */
+        void init() {
+            int N = graph.getNumberOfVertices();
+            int ndangling = 0;
+            sources.clear();
+
+            if (graph_degrees.is_open()) {
+                for (int i = 1; i <= N; i++) {
+                    if (graph_degrees.out_degree(i) == 0) {
+                        ndangling++;
+                    }
+                    if (graph.vertexNodeOwner(i)) {
+                        vertex_value_type v(1.0 / N);
+                        v.out_degree = graph_degrees.out_degree(i);
+                        graph.setVertexproperty(i, v);
+                        if (graph_degrees.in_degree(i) == 0) {
+                            sources.push_back(i);
+                        }
+                    }
+                }
+            } else {
+                count_degrees(graph, sources);
+                graph.applyReduceAllVertices(&ndangling, init_score_and_count_dangling<vertex_value_type>, add, (void*)&N);
+            }
+
+            dangling_sum = double(ndangling) / N;
+        }
+
+        bool send_message(const vertex_value_type& vertex, M& msg) const {
+            msg = vertex.out_degree > 0 ? vertex.score / vertex.out_degree : 0.0;
+            return true;
+        }
+
+        void process_message(const M& msg, const int edge, const vertex_value_type& vertex, reduce_type& result) const {
+            result = msg;
+        }
+
+        void reduce_function(reduce_type& total, const reduce_type& partial) const {
+            total += partial;
+        }
+
+        void apply(const reduce_type& total, vertex_value_type& vertex) {
+            vertex.score = (1 - damping_factor) / graph.getNumberOfVertices()
+                         + damping_factor * (total + dangling_sum / graph.getNumberOfVertices());
+        }
+
+        void do_every_iteration(int it) {
+            //Fix vertices with 0 in degrees here.
+            int N = graph.getNumberOfVertices();
+            score_type source_score = (1 - damping_factor + damping_factor * dangling_sum) / N;
+            for (size_t i = 0; i < sources.size(); i++) {
+                vertex_value_type v = graph.getVertexproperty(sources[i]);
+                v.score = source_score;
+                graph.setVertexproperty(sources[i], v);
+            }
+
+            score_type next_dangling_sum = 0.0;
+            graph.applyReduceAllVertices(&next_dangling_sum, dangling_score<vertex_value_type>, add);
+            dangling_sum = next_dangling_sum;
+        }
+};
+
+/*
+ * Vertex state of DeltaPageRankProgram. Besides the score, a vertex keeps the
+ * score its out-neighbors last heard of (sent), the change it still has to
+ * push to them (pending) and the sum of the contributions it heard from its
+ * in-neighbors (incoming), and its own id so that the program can activate
+ * it. Only a new sent value counts as a change, so the engine never
+ * activates vertices by itself; the program does.
+ */
+struct delta_vertex_value_type {
+    public:
+        score_type score;
+        score_type sent;
+        score_type pending;
+        score_type incoming;
+        int out_degree;
+        int id;
+
+        delta_vertex_value_type() {
+            score = sent = pending = incoming = 0.0;
+            out_degree = 0;
+            id = 0;
+        }
+
+        delta_vertex_value_type(score_type score_out) {
+            score = sent = pending = score_out;
+            incoming = 0.0;
+            out_degree = 0;
+            id = 0;
+        }
+
+        bool operator!=(const delta_vertex_value_type& other) const {
+            return !(out_degree == other.out_degree && sent == other.sent);
+        }
+
+        friend ostream& operator<<(ostream& stream, const delta_vertex_value_type &v) {
+            stream << v.score;
+            return stream;
+        }
+
+        score_type get_output() {
+            return score;
+        }
+};
+
+/*
+ * Per-superstep parameters of rescore, and the ids of the vertices it
+ * activates, in one list per thread.
+ */
+struct rescore_state {
+    struct padded_ids {
+        vector<int> ids;
+        char padding[64];
+    };
+
+    score_type base;
+    double damping_factor;
+    score_type epsilon;
+    vector<padded_ids> activated;
+};
+
+/*
+ * Recomputes the score of a vertex from its incoming sum, returns how much it
+ * changed, and activates the vertex if its out-neighbors need to hear of it.
+ */
+inline void rescore(delta_vertex_value_type* v, score_type* change, void* param) {
+    rescore_state *state = (rescore_state*) param;
+    score_type score = state->base + state->damping_factor * v->incoming;
+    *change = fabs(score - v->score);
+    v->score = score;
+    if (fabs(score - v->sent) > state->epsilon) {
+        v->pending = score - v->sent;
+        v->sent = score;
+        state->activated[omp_get_thread_num()].ids.push_back(v->id);
+    }
+}
+
+/*
+ * PageRank that runs until the scores converge instead of for a fixed number
+ * of iterations. Vertices push the change of their score rather than the
+ * score itself, and only once it exceeds epsilon, so after the first few
+ * iterations most vertices are inactive and send nothing. The scores of all
+ * vertices are recomputed from their incoming sums after every superstep, in
+ * parallel over the owned vertices, which also spreads the change of the
+ * dangling sum, and the L1 norm of the change (the residual) is reported.
+ * See run.
+ */
+class DeltaPageRankProgram: public GraphMat::GraphProgram<msg_type, reduce_type, delta_vertex_value_type> {
+    public:
+        double damping_factor;
+        score_type dangling_sum;
+        score_type epsilon;
+        score_type residual;
+        int iteration;
+        GraphMat::Graph<delta_vertex_value_type>& graph;
+
+        DeltaPageRankProgram(GraphMat::Graph<delta_vertex_value_type> &g, double df): damping_factor(df), graph(g) {
+            order = GraphMat::OUT_EDGES;
+            activity = GraphMat::ACTIVE_ONLY;
+    	    process_message_requires_vertexprop = false;
+            epsilon = 0.0;
+            residual = 0.0;
+            iteration = 0;
+        }
+
+        void init() {
+            int N = graph.getNumberOfVertices();
+            vector<int> sources;
+            if (!graph_degrees.is_open()) {
+                count_degrees(graph, sources);
+            }
+
+            score_type dangling = 0.0;
+            for (int i = 1; i <= N; i++) {
+                if (graph.vertexNodeOwner(i)) {
+                    delta_vertex_value_type v(1.0 / N);
+                    v.id = i;
+                    v.out_degree = graph_degrees.is_open() ? graph_degrees.out_degree(i)
+                                                           : graph.getVertexproperty(i).out_degree;
+                    graph.setVertexproperty(i, v);
+                    if (v.out_degree == 0) {
+                        dangling += v.score;
+                    }
+                }
+            }
+            MPI_Allreduce(&dangling, &dangling_sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+            residual = 0.0;
+            iteration = 0;
+        }
+
+        bool send_message(const delta_vertex_value_type& vertex, msg_type& msg) const {
+            msg = vertex.out_degree > 0 ? vertex.pending / vertex.out_degree : 0.0;
+            return vertex.out_degree > 0;
+        }
+
+        void process_message(const msg_type& msg, const int edge, const delta_vertex_value_type& vertex, reduce_type& result) const {
+            result = msg;
+        }
+
+        void reduce_function(reduce_type& total, const reduce_type& partial) const {
+            total += partial;
+        }
+
+        void apply(const reduce_type& total, delta_vertex_value_type& vertex) {
+            vertex.incoming += total;
+        }
+
+        void do_every_iteration(int it) {
+            int N = graph.getNumberOfVertices();
+            rescore_state state;
+            state.base = (1 - damping_factor + damping_factor * dangling_sum) / N;
+            state.damping_factor = damping_factor;
+            state.epsilon = epsilon;
+            state.activated.resize(omp_get_max_threads());
+
+            score_type next_residual = 0.0;
+            graph.applyReduceAllVertices(&next_residual, rescore, add, (void*)&state);
+            for (size_t t = 0; t < state.activated.size(); t++) {
+                const vector<int>& ids = state.activated[t].ids;
+                for (size_t i = 0; i < ids.size(); i++) {
+                    graph.setActive(ids[i]);
+                }
+            }
+
+            score_type next_dangling_sum = 0.0;
+            graph.applyReduceAllVertices(&next_dangling_sum, dangling_score<delta_vertex_value_type>, add);
+            residual = next_residual;
+            dangling_sum = next_dangling_sum;
+            iteration++;
+
+            if (GraphMat::get_global_myrank() == 0) {
+                cout << "iteration " << iteration << " residual: " << residual << endl;
+            }
+        }
+};
+
+/*
+ * Fixed-iteration PageRank on dense score arrays with propagation blocking
+ * (Beamer et al.), used instead of the engine when the graph image has degree
+ * arrays. The destinations are split into blocks of 2^block_bits vertices,
+ * whose sums fit in the L2 cache. Every iteration first streams the
+ * contribution of every local edge into the bin of the block of its
+ * destination, and then adds up the bins one block at a time, so neither
+ * phase reads or writes the score array at random outside of one block.
+ *
+ * The destinations of the bins are laid out once, when the kernel is opened;
+ * an iteration only writes the contributions, in the same order. Threads bin
+ * the sources of their own chunk into their own segment of every bin.
+ *
+ * The kernel holds the scores of all vertices, so it only opens in runs on a
+ * single rank. With several ranks it would have to exchange all N sums every
+ * iteration, where the engine only exchanges those of its partition, so
+ * PageRank then runs in the engine.
+ */
+class propagation_blocking {
+    public:
+        static const int block_bits = 16;
+
+        propagation_blocking() : nvertices(0), nblocks(0), nchunks(0) { }
+
+        bool is_open() const {
+            return nvertices > 0;
+        }
+
+        bool open(const char *filename) {
+            if (!single_rank() || !graph_degrees.is_open() || !is_graph_image(image_part_path(filename, 0))) {
+                return false;
+            }
+            graph_image_parts image;
+            image.open(filename);
+            return open(image);
+        }
+
+        bool open(const graph_image_parts& image) {
+            if (!single_rank() || !graph_degrees.is_open()) {
+                return false;
+            }
+            out_edges.build(image, GraphMat::OUT_EDGES);
+            nvertices = image.nvertices;
+            nblocks = (nvertices >> block_bits) + 1;
+            nchunks = omp_get_max_threads();
+
+            // Chunks of sources with about the same number of edges.
+            int64_t nedges = out_edges.neighbors.size();
+            chunk_begin.resize(nchunks + 1);
+            for (int c = 0; c <= nchunks; c++) {
+                chunk_begin[c] = lower_bound(out_edges.offsets.begin() + 1, out_edges.offsets.begin() + nvertices + 1,
+                                             nedges * c / nchunks) - out_edges.offsets.begin();
+            }
+            chunk_begin[nchunks] = nvertices + 1;
+
+            // Segment (b, c) of the bins holds the edges from chunk c into
+            // block b.
+            bin_begin.assign((int64_t) nblocks * nchunks + 1, 0);
+            #pragma omp parallel for schedule(static, 1)
+            for (int c = 0; c < nchunks; c++) {
+                for (int u = chunk_begin[c]; u < chunk_begin[c + 1]; u++) {
+                    for (int64_t i = out_edges.offsets[u]; i < out_edges.offsets[u + 1]; i++) {
+                        bin_begin[(int64_t) (out_edges.neighbors[i] >> block_bits) * nchunks + c + 1]++;
+                    }
+                }
+            }
+            for (size_t i = 1; i < bin_begin.size(); i++) {
+                bin_begin[i] += bin_begin[i - 1];
+            }
+
+            destinations.resize(nedges);
+            #pragma omp parallel for schedule(static, 1)
+            for (int c = 0; c < nchunks; c++) {
+                vector<int64_t> next = segment_starts(c);
+                for (int u = chunk_begin[c]; u < chunk_begin[c + 1]; u++) {
+                    for (int64_t i = out_edges.offsets[u]; i < out_edges.offsets[u + 1]; i++) {
+                        int32_t v = out_edges.neighbors[i];
+                        destinations[next[v >> block_bits]++] = v;
+                    }
+                }
+            }
+            return true;
+        }
+
+        /*
+         * Runs niterations of PageRank from the uniform distribution and
+         * stores the scores in the vertices. The bins hold
+         * the contributions as M and the sums are kept in double.
+         */
+        template <typename M>
+        void run(GraphMat::Graph<vertex_value_type>& graph, double damping_factor, int niterations) {
+            vector<M>& contributions = bins((M*) NULL);
+            contributions.resize(destinations.size());
+            int N = nvertices;
+            vector<score_type> scores(N + 1, 1.0 / N);
+            vector<score_type> sums(N + 1);
+
+            for (int it = 0; it < niterations; it++) {
+                #pragma omp parallel for schedule(static, 1)
+                for (int c = 0; c < nchunks; c++) {
+                    vector<int64_t> next = segment_starts(c);
+                    for (int u = chunk_begin[c]; u < chunk_begin[c + 1]; u++) {
+                        int64_t first = out_edges.offsets[u];
+                        int64_t last = out_edges.offsets[u + 1];
+                        if (first == last) {
+                            continue;
+                        }
+                        M contribution = scores[u] / graph_degrees.out_degree(u);
+                        for (int64_t i = first; i < last; i++) {
+                            contributions[next[out_edges.neighbors[i] >> block_bits]++] = contribution;
+                        }
+                    }
+                }
+
+                #pragma omp parallel for schedule(dynamic, 1)
+                for (int b = 0; b < nblocks; b++) {
+                    int first = max(1, b << block_bits);
+                    int last = (int) min((int64_t) N + 1, (int64_t) (b + 1) << block_bits);
+                    for (int v = first; v < last; v++) {
+                        sums[v] = 0.0;
+                    }
+                    int64_t end = bin_begin[(int64_t) (b + 1) * nchunks];
+                    for (int64_t i = bin_begin[(int64_t) b * nchunks]; i < end; i++) {
+                        sums[destinations[i]] += contributions[i];
+                    }
+                }
+
+                score_type dangling_sum = 0.0;
+                #pragma omp parallel for reduction(+:dangling_sum)
+                for (int v = 1; v <= N; v++) {
+                    if (graph_degrees.out_degree(v) == 0) dangling_sum += scores[v];
+                }
+                score_type base = (1 - damping_factor + damping_factor * dangling_sum) / N;
+                #pragma omp parallel for
+                for (int v = 1; v <= N; v++) {
+                    scores[v] = base + damping_factor * sums[v];
+                }
+            }
+
+            for (int v = 1; v <= N; v++) {
+                if (graph.vertexNodeOwner(v)) {
+                    vertex_value_type value = graph.getVertexproperty(v);
+                    value.score = scores[v];
+                    graph.setVertexproperty(v, value);
+                }
+            }
+        }
+
+    private:
+        int nvertices;
+        int nblocks;
+        int nchunks;
+        local_csr out_edges;
+        vector<int> chunk_begin;
+        vector<int64_t> bin_begin;
+        vector<int32_t> destinations;
+        vector<double> double_contributions;
+        vector<float> float_contributions;
+
+        vector<double>& bins(double*) {
+            return double_contributions;
+        }
+
+        vector<float>& bins(float*) {
+            return float_contributions;
+        }
+
+        static bool single_rank() {
+            int nranks;
+            MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+            return nranks == 1;
+        }
+
+        vector<int64_t> segment_starts(int chunk) const {
+            vector<int64_t> starts(nblocks);
+            for (int b = 0; b < nblocks; b++) {
+                starts[b] = bin_begin[(int64_t) b * nchunks + chunk];
+            }
+            return starts;
+        }
+};
+
+/*
+ * Relative error that Graphalytics allows in PageRank scores.
+ */
+static const double validation_tolerance = 1e-4;
+
+/*
+ * Whether scores computed from float contributions stay within the
+ * validation tolerance, judged by an a priori bound on the error rather than
+ * by measuring it. Rounding a contribution to float changes it by at
+ * most FLT_EPSILON / 2 relative to its value, so every iteration adds at most
+ * that much relative error to a score, while the damping shrinks the error
+ * inherited from earlier iterations; niterations * FLT_EPSILON bounds the
+ * total with room to spare for the summation in double.
+ */
+inline bool float_messages_are_accurate(int niterations) {
+    return niterations * (double) numeric_limits<float>::epsilon() < validation_tolerance;
+}
+
+/*
+ * Whether a fixed-iteration run sends float messages: only if the message
+ * type is "float" and the result stays accurate enough.
+ */
+inline bool use_float_messages(const string& message_type, int niterations) {
+    if (message_type != "float") {
+        return false;
+    }
+    if (!float_messages_are_accurate(niterations)) {
+        if (GraphMat::get_global_myrank() == 0) {
+            cerr << "float messages are not accurate enough for " << niterations << " iterations, sending double"
+                 << endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+void initialize(GraphMat::Graph<vertex_value_type>& graph) {
+    graph.setAllActive();
+}
+
+void initialize(GraphMat::Graph<delta_vertex_value_type>& graph) {
+    graph.setAllActive();
+}
+
+/*
+ * Runs exactly niterations, as the Graphalytics specification requires, with
+ * the blocked kernel if it is open. The tolerance only applies to
+ * DeltaPageRankProgram.
+ */
+template <typename M, typename C>
+void run(GraphMat::Graph<vertex_value_type>& graph, PageRankProgram<M>& prog, int niterations, double tolerance,
+         propagation_blocking& kernel, C *ctx) {
+    if (kernel.is_open()) {
+        kernel.run<M>(graph, prog.damping_factor, niterations);
+        return;
+    }
+    GraphMat::run_graph_program(&prog, graph, niterations, ctx);
+}
+
+/*
+ * Runs until the residual drops below the tolerance, or for at most
+ * niterations. A vertex pushes its change once it exceeds tolerance / N, so
+ * the changes held back add up to at most the tolerance.
+ */
+template <typename C>
+void run(GraphMat::Graph<delta_vertex_value_type>& graph, DeltaPageRankProgram& prog, int niterations, double tolerance,
+         propagation_blocking& kernel, C *ctx) {
+    prog.epsilon = tolerance / graph.getNumberOfVertices();
+    for (int i = 0; i < niterations; i++) {
+        GraphMat::run_graph_program(&prog, graph, 1, ctx);
+        if (prog.residual < tolerance) {
+            break;
+        }
+    }
+}
+
+}
+
+#endif
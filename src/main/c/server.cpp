@@ -0,0 +1,553 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+
+#include "bfs.hpp"
+#include "cd.hpp"
+#include "conn.hpp"
+#include "lcc.hpp"
+#include "pr.hpp"
+#include "sssp.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * gmat-server loads a graph once and runs any number of jobs on it, so that
+ * a sequence of jobs on the same graph pays for MPI start-up and graph loading
+ * only once.
+ *
+ * Rank 0 listens on a UNIX socket. Every connection carries a single request
+ * line: the name of a benchmark binary followed by the arguments of that
+ * binary without the graph file, e.g. "bfs 1 job-1 /tmp/output". The request
+ * is broadcast to all ranks, which run the job on the resident graph, and
+ * rank 0 answers with the processing timestamps followed by "OK" or
+ * "ERROR <message>". The request "ping" checks that the server is up, "quit"
+ * stops it. Requests are served one at a time.
+ *
+ * Only the graph and the kernel of the last job stay resident; a job on a
+ * different vertex type or kernel frees them first (see server_state::use).
+ */
+
+class resident_graph_base {
+    public:
+        virtual ~resident_graph_base() { }
+
+        virtual void release() = 0;
+};
+
+/*
+ * Graph kept resident for one vertex type. The graph is built from the mapped
+ * image on first use; later jobs only reset the vertex state. Every build
+ * copies the edges, as the engine may reorder the array it is given.
+ */
+template <typename V, typename E = int>
+class resident_graph : public resident_graph_base {
+    public:
+        resident_graph() : graph(NULL) { }
+
+        ~resident_graph() {
+            delete graph;
+        }
+
+        void release() {
+            delete graph;
+            graph = NULL;
+        }
+
+        GraphMat::Graph<V, E>& get(const char *filename, const graph_image_parts *image, bool vertices_only) {
+            if (graph == NULL) {
+                graph = new GraphMat::Graph<V, E>();
+                if (image != NULL && vertices_only) {
+                    load_vertices(*graph, image->nvertices);
+                } else if (image != NULL) {
+                    load_graph(*graph, *image, true);
+                } else {
+                    graph->ReadGraphMatBin(filename);
+                }
+            } else {
+                graph->setAllVertexproperty(V());
+                graph->setAllInactive();
+            }
+            return *graph;
+        }
+
+    private:
+        GraphMat::Graph<V, E> *graph;
+};
+
+struct server_state {
+    const char *filename;
+    graph_image_parts image;
+    bool is_image;
+
+    resident_graph<bfs::vertex_value_type> bfs_graph;
+    resident_graph<bfs::multi_source_value_type> multi_source_bfs_graph;
+    bfs::direction_optimizer bfs_optimizer;
+    resident_graph<pr::vertex_value_type> pr_graph;
+    resident_graph<pr::delta_vertex_value_type> delta_pr_graph;
+    pr::propagation_blocking pr_kernel;
+    resident_graph<conn::vertex_value_type> conn_graph;
+    conn::union_find conn_components;
+    resident_graph<cd::vertex_value_type> cd_graph;
+    cd::label_propagation cd_propagation;
+    resident_graph<lcc::vertex_value_type, int> lcc_graph;
+    lcc::triangle_counter lcc_counter;
+    resident_graph<sssp::vertex_value_type<int64_t>, int32_t> sssp_int32_graph;
+    resident_graph<sssp::vertex_value_type<float>, float> sssp_float_graph;
+    resident_graph<sssp::vertex_value_type<double>, double> sssp_double_graph;
+
+    const graph_image_parts* image_or_null() const {
+        return is_image ? &image : NULL;
+    }
+
+    /*
+     * Returns the resident graph for the next job, after freeing every other
+     * graph and every kernel but the one the job runs on (NULL for none). A
+     * kernel that keeps its own adjacency asks for the vertices only, which
+     * it gets when the graph is an image.
+     */
+    template <typename V, typename E>
+    GraphMat::Graph<V, E>& use(resident_graph<V, E>& resident, const void *kernel, bool vertices_only = false) {
+        resident_graph_base *graphs[] = {
+            &bfs_graph, &multi_source_bfs_graph, &pr_graph, &delta_pr_graph, &conn_graph, &cd_graph, &lcc_graph,
+            &sssp_int32_graph, &sssp_float_graph, &sssp_double_graph
+        };
+        for (size_t i = 0; i < sizeof(graphs) / sizeof(graphs[0]); i++) {
+            if (graphs[i] != &resident) graphs[i]->release();
+        }
+        release_unless(bfs_optimizer, kernel);
+        release_unless(pr_kernel, kernel);
+        release_unless(conn_components, kernel);
+        release_unless(cd_propagation, kernel);
+        release_unless(lcc_counter, kernel);
+        return resident.get(filename, image_or_null(), vertices_only);
+    }
+
+    template <typename K>
+    static void release_unless(K& kernel, const void *keep) {
+        if (&kernel != keep) kernel = K();
+    }
+};
+
+struct job_times {
+    string start;
+    string end;
+};
+
+static const char* output_argument(const vector<string>& args, size_t index) {
+    return args.size() > index ? args[index].c_str() : NULL;
+}
+
+static string run_multi_source_bfs(server_state& server, const vector<int>& sources, const vector<string>& args,
+                                   job_times& times) {
+    timer_next("initialize engine");
+    GraphMat::Graph<bfs::multi_source_value_type>& graph =
+        server.use(server.multi_source_bfs_graph, NULL);
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i] < 1 || sources[i] > graph.nvertices) {
+            return "invalid source vertex";
+        }
+    }
+
+    times.start = getEpoch();
+    timer_next("run algorithm");
+    bfs::run_multi_source(graph, sources, output_argument(args, 2));
+    times.end = getEpoch();
+    return "";
+}
+
+static string run_bfs(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 2) {
+        return "usage: bfs <source vertex | source,source,... | @source file> <job id> [output file]";
+    }
+    vector<int> sources;
+    if (!bfs::parse_sources(args[0].c_str(), sources)) {
+        return "invalid source vertex list";
+    }
+    if (sources.size() > 1) {
+        return run_multi_source_bfs(server, sources, args, times);
+    }
+    int source_vertex = sources[0];
+
+    timer_next("initialize engine");
+    GraphMat::Graph<bfs::vertex_value_type>& graph = server.use(server.bfs_graph, &server.bfs_optimizer);
+    if (source_vertex < 1 || source_vertex > graph.nvertices) {
+        return "invalid source vertex";
+    }
+    bfs::initialize(graph, source_vertex);
+
+    bfs::BreadthFirstSearch prog;
+    auto ctx = GraphMat::graph_program_init(prog, graph);
+
+    times.start = getEpoch();
+    timer_next("run algorithm");
+    if (server.is_image && !server.bfs_optimizer.is_open()) {
+        server.bfs_optimizer.open(server.image);
+    }
+    server.bfs_optimizer.run(graph, prog, source_vertex, &ctx);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<bfs::vertex_value_type, int, bfs::depth_type>(output_argument(args, 2), graph, MPI_UNSIGNED);
+
+    GraphMat::graph_program_clear(ctx);
+    return "";
+}
+
+template <typename V, typename P>
+static string run_pr(resident_graph<V>& resident, server_state& server, int niterations, double damping_factor,
+                     double tolerance, const vector<string>& args, job_times& times) {
+    timer_next("initialize engine");
+    // Only the fixed-iteration program runs on the blocked kernel.
+    bool blocked = tolerance <= 0;
+    GraphMat::Graph<V>& graph = server.use(resident, blocked ? &server.pr_kernel : NULL);
+    pr::initialize(graph);
+
+    P pr_prog(graph, damping_factor);
+    auto ctx = GraphMat::graph_program_init(pr_prog, graph);
+
+    times.start = getEpoch();
+    timer_next("initialize vertices");
+    pr_prog.init();
+
+    timer_next("run algorithm (compute PageRank)");
+    if (blocked && server.is_image && !server.pr_kernel.is_open()) {
+        server.pr_kernel.open(server.image);
+    }
+    pr::run(graph, pr_prog, niterations, tolerance, server.pr_kernel, &ctx);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<V, int, pr::score_type>(output_argument(args, 5), graph, MPI_DOUBLE);
+
+    GraphMat::graph_program_clear(ctx);
+    return "";
+}
+
+static string run_pr(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 5) {
+        return "usage: pr <num iterations> <damping factor> <tolerance> <message type> <job id> [output file]";
+    }
+    int niterations = atoi(args[0].c_str());
+    double damping_factor = atof(args[1].c_str());
+    double tolerance = atof(args[2].c_str());
+
+    if (tolerance > 0) {
+        return run_pr<pr::delta_vertex_value_type, pr::DeltaPageRankProgram>(server.delta_pr_graph, server, niterations,
+                                                                             damping_factor, tolerance, args, times);
+    }
+    if (pr::use_float_messages(args[3], niterations)) {
+        return run_pr<pr::vertex_value_type, pr::PageRankProgram<float> >(server.pr_graph, server, niterations,
+                                                                          damping_factor, tolerance, args, times);
+    }
+    return run_pr<pr::vertex_value_type, pr::PageRankProgram<double> >(server.pr_graph, server, niterations,
+                                                                       damping_factor, tolerance, args, times);
+}
+
+static string run_conn(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 1) {
+        return "usage: conn <job id> [output file]";
+    }
+
+    timer_next("initialize engine");
+    GraphMat::Graph<conn::vertex_value_type>& graph = server.use(server.conn_graph, &server.conn_components);
+    conn::initialize(graph);
+
+    conn::WeaklyConnectedComponents prog;
+    auto ctx = GraphMat::graph_program_init(prog, graph);
+
+    times.start = getEpoch();
+    timer_next("run algorithm");
+    if (server.is_image && !server.conn_components.is_open()) {
+        server.conn_components.open(server.image);
+    }
+    server.conn_components.run(graph, prog, &ctx);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<conn::vertex_value_type, int, conn::component_type>(output_argument(args, 1), graph, MPI_INT);
+
+    GraphMat::graph_program_clear(ctx);
+    return "";
+}
+
+static string run_cd(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 3) {
+        return "usage: cd <niterations> <job id> <isDirected> [output file]";
+    }
+    int niterations = atoi(args[0].c_str());
+    int isDirected = atoi(args[2].c_str());
+
+    timer_next("initialize engine");
+    GraphMat::Graph<cd::vertex_value_type>& graph = server.use(server.cd_graph, &server.cd_propagation);
+    cd::initialize(graph);
+
+    cd::CommunityDetectionProgram prog(isDirected);
+    auto ctx = GraphMat::graph_program_init(prog, graph);
+
+    times.start = getEpoch();
+    timer_next("run algorithm");
+    if (server.is_image && !server.cd_propagation.is_open()) {
+        server.cd_propagation.open(server.image);
+    }
+    server.cd_propagation.run(graph, prog, niterations, &ctx);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<cd::vertex_value_type, int, cd::label_type>(output_argument(args, 3), graph, MPI_INT, true);
+
+    GraphMat::graph_program_clear(ctx);
+    return "";
+}
+
+static string run_lcc(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 2) {
+        return "usage: lcc <job id> <isDirected> [output file]";
+    }
+    int isDirected = atoi(args[1].c_str());
+
+    timer_next("initialize engine");
+    GraphMat::Graph<lcc::vertex_value_type, int>& graph = server.use(server.lcc_graph, &server.lcc_counter, true);
+    lcc::initialize(graph);
+
+    times.start = getEpoch();
+    timer_next("run algorithm (build adjacency)");
+    if (server.is_image && !server.lcc_counter.is_open()) {
+        server.lcc_counter.open(server.image);
+    }
+    server.lcc_counter.run(graph, isDirected);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<lcc::vertex_value_type, int, double>(output_argument(args, 2), graph, MPI_DOUBLE);
+    return "";
+}
+
+static resident_graph<sssp::vertex_value_type<int64_t>, int32_t>& sssp_graph(server_state& server, int32_t*) {
+    return server.sssp_int32_graph;
+}
+
+static resident_graph<sssp::vertex_value_type<float>, float>& sssp_graph(server_state& server, float*) {
+    return server.sssp_float_graph;
+}
+
+static resident_graph<sssp::vertex_value_type<double>, double>& sssp_graph(server_state& server, double*) {
+    return server.sssp_double_graph;
+}
+
+template <typename E, typename D = typename sssp::distance_type_of<E>::type>
+static string run_sssp(server_state& server, int source_vertex, sssp::depth_type delta, const vector<string>& args,
+                       job_times& times) {
+    timer_next("initialize engine");
+    GraphMat::Graph<sssp::vertex_value_type<D>, E>& graph =
+        server.use(sssp_graph(server, (E*) NULL), NULL);
+    if (source_vertex < 1 || source_vertex > graph.nvertices) {
+        return "invalid source vertex";
+    }
+    sssp::initialize(graph, source_vertex);
+    if (delta <= 0 && server.is_image) {
+        delta = sssp::choose_delta(server.image);
+    }
+
+    sssp::SingleSourceShortestPath<E, D> prog;
+    auto ctx = GraphMat::graph_program_init(prog, graph);
+
+    times.start = getEpoch();
+    timer_next("run algorithm");
+    sssp::run_delta_stepping(graph, prog, source_vertex, delta, &ctx);
+    times.end = getEpoch();
+
+    timer_next("print output");
+    print_graph<sssp::vertex_value_type<D>, E, sssp::depth_type>(output_argument(args, 3), graph, MPI_DOUBLE);
+
+    GraphMat::graph_program_clear(ctx);
+    return "";
+}
+
+static string run_sssp(server_state& server, const vector<string>& args, job_times& times) {
+    if (args.size() < 3) {
+        return "usage: sssp <source vertex> <delta> <job id> [output file]";
+    }
+    int source_vertex = atoi(args[0].c_str());
+    sssp::depth_type delta = atof(args[1].c_str());
+
+    // Run with the edge value type of the image, so weights stay compact.
+    uint32_t value_type = server.is_image ? server.image.value_type : (uint32_t) IMAGE_DOUBLE;
+    switch (value_type) {
+        case IMAGE_INT32: return run_sssp<int32_t>(server, source_vertex, delta, args, times);
+        case IMAGE_FLOAT: return run_sssp<float>(server, source_vertex, delta, args, times);
+        default: return run_sssp<double>(server, source_vertex, delta, args, times);
+    }
+}
+
+static string run_job(server_state& server, const string& algorithm, const vector<string>& args, job_times& times) {
+    if (algorithm == "bfs") return run_bfs(server, args, times);
+    if (algorithm == "pr") return run_pr(server, args, times);
+    if (algorithm == "conn") return run_conn(server, args, times);
+    if (algorithm == "cd") return run_cd(server, args, times);
+    if (algorithm == "lcc") return run_lcc(server, args, times);
+    if (algorithm == "sssp") return run_sssp(server, args, times);
+    return "unknown algorithm: " + algorithm;
+}
+
+static int listen_on(const char *path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        cerr << "socket path is too long: " << path << endl;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || ::bind(fd, (sockaddr*) &address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        cerr << "failed to listen on " << path << ": " << strerror(errno) << endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool read_request(int fd, string& request) {
+    request.clear();
+    char c;
+    while (request.size() < (1 << 16)) {
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return !request.empty();
+        if (c == '\n') return true;
+        request += c;
+    }
+    return false;
+}
+
+static void write_reply(int fd, const string& reply) {
+    for (size_t done = 0; done < reply.size(); ) {
+        ssize_t n = write(fd, reply.data() + done, reply.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        done += n;
+    }
+}
+
+static void broadcast_request(string& request) {
+    int length = request.size();
+    MPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    request.resize(length);
+    if (length > 0) {
+        MPI_Bcast(&request[0], length, MPI_CHAR, 0, MPI_COMM_WORLD);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    MPI_Init(&argc, &argv);
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " <graph file> <socket path>" << endl;
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    bool is_master = GraphMat::get_global_myrank() == 0;
+    server_state server;
+    server.filename = argv[1];
+    const char *socket_path = argv[2];
+
+    load_graph_metadata(server.filename);
+    server.is_image = is_graph_image(image_part_path(server.filename, 0));
+    if (server.is_image) {
+        server.image.open(server.filename);
+    }
+
+    int listen_fd = -1;
+    if (is_master) {
+        signal(SIGPIPE, SIG_IGN);
+        listen_fd = listen_on(socket_path);
+    }
+    int listening = listen_fd >= 0;
+    MPI_Bcast(&listening, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!listening) {
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+    if (is_master) cout << "serving " << server.filename << " on " << socket_path << endl;
+
+    while (true) {
+        int client_fd = -1;
+        string request;
+        if (is_master) {
+            client_fd = accept(listen_fd, NULL, NULL);
+            if (client_fd < 0 || !read_request(client_fd, request)) {
+                if (client_fd >= 0) close(client_fd);
+                continue;
+            }
+        }
+        broadcast_request(request);
+
+        istringstream words(request);
+        string algorithm;
+        vector<string> args;
+        words >> algorithm;
+        for (string word; words >> word; ) {
+            args.push_back(word);
+        }
+
+        string reply;
+        if (algorithm == "quit" || algorithm == "ping") {
+            reply = "OK\n";
+        } else {
+            if (is_master) cout << "running job: " << request << endl;
+            job_times times;
+            timer_start(is_master);
+            string error = run_job(server, algorithm, args, times);
+            timer_end();
+
+            if (!times.start.empty()) reply += "Processing starts at: " + times.start + "\n";
+            if (!times.end.empty()) reply += "Processing ends at: " + times.end + "\n";
+            reply += error.empty() ? "OK\n" : "ERROR " + error + "\n";
+        }
+
+        if (is_master) {
+            write_reply(client_fd, reply);
+            close(client_fd);
+        }
+        if (algorithm == "quit") {
+            break;
+        }
+    }
+
+    if (is_master) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
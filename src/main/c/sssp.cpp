@@ -15,108 +15,19 @@
  */
 #include "GraphMatRuntime.h"
 #include "common.hpp"
+#include "sssp.hpp"
 
-#include <limits>
-#include <omp.h>
-#include <stdint.h>
-#include <algorithm>
 #include <iostream>
-#include <chrono>
 
 #ifdef GRANULA
 #include "granula.hpp"
 #endif
 
 using namespace std;
+using namespace sssp;
 
-typedef double depth_type;
-typedef depth_type msg_type;
-typedef depth_type reduce_type;
-typedef depth_type edge_value_type;
-
-struct vertex_value_type {
-    public:
-        depth_type curr;
-
-        vertex_value_type() {
-            curr = numeric_limits<depth_type>::max();
-        }
-
-        vertex_value_type(depth_type d) {
-            curr = d;
-        }
-
-        bool operator!= (const vertex_value_type& other) const {
-            return !(curr == other.curr);
-        }
-
-        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
-            if (v.curr != numeric_limits<depth_type>::max()) {
-                stream << v.curr;
-            } else {
-                stream << "inf";
-            }
-
-            return stream;
-        }
-
-        depth_type get_output() {
-            return curr;
-        }
-};
-
-class SingleSourceShortestPath: public GraphMat::GraphProgram<msg_type, reduce_type, vertex_value_type, edge_value_type> {
-    public:
-	SingleSourceShortestPath() {
-    	    process_message_requires_vertexprop = false;
-	}
-        bool send_message(const vertex_value_type& vertex, msg_type& msg) const {
-            msg = vertex.curr;
-            return true;
-        }
-
-        void reduce_function(reduce_type& total, const reduce_type& partial) const {
-            total = min(total, partial);
-        }
-
-        void process_message(const msg_type& msg, const edge_value_type edge_value, const vertex_value_type& vertex, reduce_type& result) const {
-            result = msg + edge_value;
-        }
-
-        void apply(const reduce_type& msg, vertex_value_type& vertex) {
-            vertex.curr = min(vertex.curr, msg);
-        }
-
-};
-
-string getEpoch() {
-    return to_string(chrono::duration_cast<chrono::milliseconds>
-        (chrono::system_clock::now().time_since_epoch()).count());
-}
-
-
-int main(int argc, char *argv[]) {
-
-#ifdef GRANULA
-    granula::startMonitorProcess(getpid());
-#endif
-
-    MPI_Init(&argc, &argv);
-    if (argc < 3) {
-        cerr << "usage: " << argv[0] << " <graph file> <source vertex> [output file]" << endl;
-        return EXIT_FAILURE;
-    }
-
-    bool is_master = GraphMat::get_global_myrank() == 0;
-    char *filename = argv[1];
-    int source_vertex = atoi(argv[2]);
-    string jobId = argc > 3 ? argv[3] : NULL;
-    char *output = argc > 4 ? argv[4] : NULL;
-
-    if (is_master) cout << "source vertex: " << source_vertex << endl;
-
-    //nthreads = omp_get_max_threads();
-    //if (is_master) cout << "num. threads: " << nthreads << endl;
+template <typename E, typename D = typename distance_type_of<E>::type>
+int run(char *filename, int source_vertex, depth_type delta, const string& jobId, char *output, bool is_master) {
 
 #ifdef GRANULA
     granula::linkNode(jobId);
@@ -131,25 +42,26 @@ int main(int argc, char *argv[]) {
     timer_start(is_master);
 
     timer_next("load graph");
-    GraphMat::Graph<vertex_value_type, edge_value_type> graph;
+    GraphMat::Graph<vertex_value_type<D>, E> graph;
     //graph.ReadMTX(filename);
-    graph.ReadGraphMatBin(filename);
+    load_graph(graph, filename);
 
 #ifdef GRANULA
     if (is_master) cout<<loadGraph.getOperationInfo("EndTime", loadGraph.getEpoch())<<endl;
 #endif
 
     timer_next("initialize engine");
-    if (source_vertex < 0 || source_vertex >= graph.nvertices) {
-        cerr << "ERROR: invalid source vertex (not in range [0, " << graph.nvertices-1 << "]" << endl;
+    if (source_vertex < 1 || source_vertex > graph.nvertices) {
+        cerr << "ERROR: invalid source vertex (not in range [1, " << graph.nvertices << "]" << endl;
         return EXIT_FAILURE;
     }
 
-    graph.setAllInactive();
-    graph.setVertexproperty(source_vertex, vertex_value_type(0));
-    graph.setActive(source_vertex);
+    initialize(graph, source_vertex);
+    // A delta of 0 picks the bucket width from the edge weights.
+    if (delta <= 0) delta = choose_delta(filename);
+    if (is_master) cout << "delta: " << delta << endl;
 
-    SingleSourceShortestPath prog;
+    SingleSourceShortestPath<E, D> prog;
     auto ctx = GraphMat::graph_program_init(prog, graph);
 
 #ifdef GRANULA
@@ -159,7 +71,7 @@ int main(int argc, char *argv[]) {
 
     if (is_master) cout<< "Processing starts at: " + getEpoch() + "\n" <<endl;
     timer_next("run algorithm");
-    GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, &ctx);
+    run_delta_stepping(graph, prog, source_vertex, delta, &ctx);
     if (is_master) cout<< "Processing ends at: " + getEpoch() + "\n" <<endl;
 
 #ifdef GRANULA
@@ -172,7 +84,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     timer_next("print output");
-    print_graph<vertex_value_type, edge_value_type, depth_type>(output, graph, MPI_DOUBLE);
+    print_graph<vertex_value_type<D>, E, depth_type>(output, graph, MPI_DOUBLE);
 
 #ifdef GRANULA
     if (is_master) cout<<offloadGraph.getOperationInfo("EndTime", offloadGraph.getEpoch())<<endl;
@@ -189,7 +101,50 @@ int main(int argc, char *argv[]) {
     granula::stopMonitorProcess(getpid());
 #endif
 
-    MPI_Finalize();
     return EXIT_SUCCESS;
 }
 
+int main(int argc, char *argv[]) {
+
+#ifdef GRANULA
+    granula::startMonitorProcess(getpid());
+#endif
+
+    MPI_Init(&argc, &argv);
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " <graph file> <source vertex> [delta] [job id] [output file]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    bool is_master = GraphMat::get_global_myrank() == 0;
+    char *filename = argv[1];
+    int source_vertex = atoi(argv[2]);
+    depth_type delta = argc > 3 ? atof(argv[3]) : 0;
+    string jobId = argc > 4 ? argv[4] : NULL;
+    char *output = argc > 5 ? argv[5] : NULL;
+
+    if (is_master) cout << "source vertex: " << source_vertex << endl;
+
+    //nthreads = omp_get_max_threads();
+    //if (is_master) cout << "num. threads: " << nthreads << endl;
+
+    // Images carry their edge value type; other inputs are read as double.
+    uint32_t value_type = IMAGE_DOUBLE;
+    read_image_value_type(image_part_path(filename, 0), value_type);
+
+    int status;
+    switch (value_type) {
+        case IMAGE_INT32:
+            status = run<int32_t>(filename, source_vertex, delta, jobId, output, is_master);
+            break;
+        case IMAGE_FLOAT:
+            status = run<float>(filename, source_vertex, delta, jobId, output, is_master);
+            break;
+        default:
+            status = run<double>(filename, source_vertex, delta, jobId, output, is_master);
+            break;
+    }
+
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SSSP_HPP
+#define SSSP_HPP
+
+#include <limits>
+#include <omp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <map>
+
+#include "GraphMatRuntime.h"
+#include "common.hpp"
+
+namespace sssp {
+
+using namespace std;
+
+/*
+ * SSSP is instantiated for the edge value type stored in the graph image:
+ * int32 weights are summed into int64 distances, float weights into float
+ * distances and double weights into double distances. Output is always
+ * written as double, with unreachable vertices at the maximum double.
+ */
+typedef double depth_type;
+
+template <typename E> struct distance_type_of;
+template <> struct distance_type_of<int32_t> { typedef int64_t type; };
+template <> struct distance_type_of<float> { typedef float type; };
+template <> struct distance_type_of<double> { typedef double type; };
+
+template <typename D>
+struct vertex_value_type {
+    public:
+        D curr;
+        int32_t id;
+
+        vertex_value_type() {
+            curr = numeric_limits<D>::max();
+            id = 0;
+        }
+
+        vertex_value_type(depth_type d, int32_t v = 0) {
+            curr = d >= (depth_type) numeric_limits<D>::max() ? numeric_limits<D>::max() : (D) d;
+            id = v;
+        }
+
+        bool operator!= (const vertex_value_type& other) const {
+            return !(curr == other.curr);
+        }
+
+        friend ostream& operator<< (ostream& stream, const vertex_value_type &v) {
+            if (v.curr != numeric_limits<D>::max()) {
+                stream << v.curr;
+            } else {
+                stream << "inf";
+            }
+
+            return stream;
+        }
+
+        depth_type get_output() {
+            return curr != numeric_limits<D>::max() ? (depth_type) curr : numeric_limits<depth_type>::max();
+        }
+};
+
+/*
+ * The vertices whose distance went down in one superstep, with their new
+ * distance, one list per thread.
+ */
+template <typename D>
+class improved_vertices {
+    public:
+        vector<vector<pair<int32_t, D> > > lists;
+
+        improved_vertices() : lists(omp_get_max_threads()) { }
+
+        void add(int32_t vertex, D distance) {
+            lists[omp_get_thread_num()].push_back(make_pair(vertex, distance));
+        }
+
+        void clear() {
+            for (size_t t = 0; t < lists.size(); t++) {
+                lists[t].clear();
+            }
+        }
+};
+
+inline long long bucket_of(depth_type distance, depth_type delta) {
+    return (long long) min(distance / delta, (depth_type) (LLONG_MAX / 2));
+}
+
+template <typename E, typename D = typename distance_type_of<E>::type>
+class SingleSourceShortestPath: public GraphMat::GraphProgram<D, D, vertex_value_type<D>, E> {
+    public:
+        // Without a bucket width, every active vertex relaxes its edges.
+        depth_type delta;
+        long long bucket;
+        improved_vertices<D> *improved;
+
+	SingleSourceShortestPath() {
+            delta = 0;
+            bucket = 0;
+            improved = NULL;
+    	    this->process_message_requires_vertexprop = false;
+	}
+
+        // Only vertices whose distance went down, and lies in the current
+        // bucket, relax their edges. Membership is decided by bucket_of, as
+        // in run_delta_stepping, so that both agree at the bucket bounds.
+        bool send_message(const vertex_value_type<D>& vertex, D& msg) const {
+            msg = vertex.curr;
+            return !(delta > 0) || bucket_of(vertex.curr, delta) == bucket;
+        }
+
+        void reduce_function(D& total, const D& partial) const {
+            total = min(total, partial);
+        }
+
+        void process_message(const D& msg, const E edge_value, const vertex_value_type<D>& vertex, D& result) const {
+            result = msg + edge_value;
+        }
+
+        void apply(const D& msg, vertex_value_type<D>& vertex) {
+            if (msg < vertex.curr) {
+                vertex.curr = msg;
+                if (improved != NULL) improved->add(vertex.id, msg);
+            }
+        }
+
+};
+
+template <typename D, typename E>
+void initialize(GraphMat::Graph<vertex_value_type<D>, E>& graph, int source_vertex) {
+    graph.setAllInactive();
+    for (int v = 1; v <= graph.getNumberOfVertices(); v++) {
+        if (graph.vertexNodeOwner(v)) {
+            graph.setVertexproperty(v, vertex_value_type<D>(numeric_limits<depth_type>::max(), v));
+        }
+    }
+    graph.setVertexproperty(source_vertex, vertex_value_type<D>(0, source_vertex));
+    graph.setActive(source_vertex);
+}
+
+template <typename W>
+void add_weight_statistics(const mapped_image& part, double& sum, double& min_weight) {
+    const image_edge<W> *edges = (const image_edge<W>*) part.edges();
+    int64_t n = part.header().nedges;
+    double part_sum = 0;
+    double part_min = min_weight;
+    #pragma omp parallel for reduction(+:part_sum) reduction(min:part_min)
+    for (int64_t i = 0; i < n; i++) {
+        part_sum += edges[i].val;
+        if (edges[i].val > 0) part_min = min(part_min, (double) edges[i].val);
+    }
+    sum += part_sum;
+    min_weight = part_min;
+}
+
+/*
+ * Picks the bucket width for delta-stepping from the edge weights of the
+ * image: the mean weight times 8 / average degree, but at least the smallest
+ * positive weight. Buckets of sparse, road-like graphs then span a few hops,
+ * while buckets of dense graphs stay narrow enough not to turn into
+ * Bellman-Ford. Returns 0 (no buckets) if the graph has no edges.
+ */
+inline depth_type choose_delta(const graph_image_parts& image) {
+    double sums[2] = { 0, (double) image.nedges };
+    double min_weight = numeric_limits<double>::max();
+    for (size_t p = 0; p < image.parts.size(); p++) {
+        switch (image.parts[p].header().value_type) {
+            case IMAGE_INT32: add_weight_statistics<int32_t>(image.parts[p], sums[0], min_weight); break;
+            case IMAGE_FLOAT: add_weight_statistics<float>(image.parts[p], sums[0], min_weight); break;
+            case IMAGE_DOUBLE: add_weight_statistics<double>(image.parts[p], sums[0], min_weight); break;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &min_weight, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+
+    if (sums[1] == 0 || sums[0] <= 0) {
+        return 0;
+    }
+    double mean_weight = sums[0] / sums[1];
+    double average_degree = max(1.0, sums[1] / image.nvertices);
+    return max(mean_weight * 8 / average_degree, min_weight);
+}
+
+inline depth_type choose_delta(const char *filename) {
+    if (!is_graph_image(image_part_path(filename, 0))) {
+        return 0;
+    }
+    graph_image_parts image;
+    image.open(filename);
+    return choose_delta(image);
+}
+
+/*
+ * Delta-stepping (Meyer and Sanders). Vertices are kept in buckets of width
+ * delta by their tentative distance, and the buckets are settled in order:
+ * the vertices of the current bucket relax their edges, and the vertices
+ * whose distance went down into the same bucket relax theirs in the next
+ * superstep, until the bucket is empty. Vertices that improve into a later
+ * bucket wait there, so they relax their edges once instead of once per
+ * improvement. The engine runs one superstep at a time; the buckets only
+ * hold the vertices this rank owns and may hold stale entries, which are
+ * skipped. With delta 0 the search runs as a single Bellman-Ford phase.
+ */
+template <typename E, typename D, typename C>
+void run_delta_stepping(GraphMat::Graph<vertex_value_type<D>, E>& graph, SingleSourceShortestPath<E, D>& prog,
+                        int source_vertex, depth_type delta, C *ctx) {
+    if (!(delta > 0)) {
+        GraphMat::run_graph_program(&prog, graph, GraphMat::UNTIL_CONVERGENCE, ctx);
+        return;
+    }
+
+    improved_vertices<D> improved;
+    prog.improved = &improved;
+    prog.delta = delta;
+    map<long long, vector<int32_t> > buckets;
+    if (graph.vertexNodeOwner(source_vertex)) buckets[0].push_back(source_vertex);
+
+    while (true) {
+        long long current = buckets.empty() ? LLONG_MAX : buckets.begin()->first;
+        MPI_Allreduce(MPI_IN_PLACE, &current, 1, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+        if (current == LLONG_MAX) {
+            break;
+        }
+
+        graph.setAllInactive();
+        if (!buckets.empty() && buckets.begin()->first == current) {
+            const vector<int32_t>& members = buckets.begin()->second;
+            for (size_t i = 0; i < members.size(); i++) {
+                if (bucket_of(graph.getVertexproperty(members[i]).curr, delta) == current) {
+                    graph.setActive(members[i]);
+                }
+            }
+            buckets.erase(buckets.begin());
+        }
+        prog.bucket = current;
+
+        long long remaining;
+        do {
+            improved.clear();
+            GraphMat::run_graph_program(&prog, graph, 1, ctx);
+
+            remaining = 0;
+            for (size_t t = 0; t < improved.lists.size(); t++) {
+                for (size_t i = 0; i < improved.lists[t].size(); i++) {
+                    long long bucket = bucket_of(improved.lists[t][i].second, delta);
+                    if (bucket == current) {
+                        remaining++;
+                    } else {
+                        buckets[bucket].push_back(improved.lists[t][i].first);
+                    }
+                }
+            }
+            MPI_Allreduce(MPI_IN_PLACE, &remaining, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        } while (remaining > 0);
+    }
+
+    prog.improved = NULL;
+    prog.delta = 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package science.atlarge.graphalytics.graphmat;
+
+import org.apache.logging.log4j.LogManager;
+import org.apache.logging.log4j.Logger;
+
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.util.List;
+
+/**
+ * Cache of converted graphs that is kept across benchmark sessions. Converted graphs are stored under a key derived
+ * from the content of the vertex and edge files and from the conversion flags, so a graph is only converted again
+ * when its input or the way it is converted changes.
+ */
+public final class GraphCache {
+
+	private static final Logger LOG = LogManager.getLogger(GraphCache.class);
+
+	/** Bump when the converter output changes, so that stale images are not reused. */
+	private static final String FORMAT_VERSION = "graphmat-image-2";
+	private static final String COMPLETE_EXTENSION = ".complete";
+
+	private final File directory;
+
+	public GraphCache(String directory) throws IOException {
+		this.directory = new File(directory).getAbsoluteFile();
+
+		if (!this.directory.isDirectory() && !this.directory.mkdirs()) {
+			throw new IOException("failed to create graph cache directory: " + directory);
+		}
+	}
+
+	/**
+	 * Computes the cache key of a graph: a SHA-256 digest of the conversion flags and the content of the input files.
+	 *
+	 * @param flags the flags passed to the converter
+	 * @param inputFiles the paths of the vertex and edge files
+	 * @return the cache key as a hexadecimal string
+	 * @throws IOException iff an input file could not be read
+	 */
+	public static String key(List<String> flags, String... inputFiles) throws IOException {
+		MessageDigest digest;
+		try {
+			digest = MessageDigest.getInstance("SHA-256");
+		} catch (NoSuchAlgorithmException e) {
+			throw new IOException("SHA-256 is not available", e);
+		}
+
+		digest.update(FORMAT_VERSION.getBytes(StandardCharsets.UTF_8));
+		for (String flag : flags) {
+			digest.update((byte) 0);
+			digest.update(flag.getBytes(StandardCharsets.UTF_8));
+		}
+
+		ByteBuffer buffer = ByteBuffer.allocateDirect(1 << 20);
+		for (String inputFile : inputFiles) {
+			try (FileChannel channel = new FileInputStream(inputFile).getChannel()) {
+				digest.update(ByteBuffer.allocate(8).putLong(0, channel.size()));
+				while (channel.read(buffer) >= 0) {
+					buffer.flip();
+					digest.update(buffer);
+					buffer.clear();
+				}
+			}
+		}
+
+		StringBuilder key = new StringBuilder();
+		for (byte b : digest.digest()) {
+			key.append(String.format("%02x", b));
+		}
+		return key.toString();
+	}
+
+	/**
+	 * @param key a cache key
+	 * @return the path under which the converted graph with the given key is stored
+	 */
+	public String pathOf(String key) {
+		return new File(directory, key + ".img").getPath();
+	}
+
+	/**
+	 * @param key a cache key
+	 * @return true iff a complete conversion of the graph with the given key is stored in the cache
+	 */
+	public boolean contains(String key) {
+		return new File(pathOf(key) + COMPLETE_EXTENSION).exists();
+	}
+
+	/**
+	 * Marks the graph stored under a key as complete. Conversions that did not finish are never reused, but are
+	 * overwritten by the next conversion of the same graph.
+	 *
+	 * @param key a cache key
+	 * @throws IOException iff the graph could not be marked as complete
+	 */
+	public void commit(String key) throws IOException {
+		File marker = new File(pathOf(key) + COMPLETE_EXTENSION);
+		if (!marker.exists() && !marker.createNewFile()) {
+			throw new IOException("failed to create " + marker);
+		}
+		LOG.info("Stored converted graph in cache: {}", pathOf(key));
+	}
+
+	/**
+	 * @param path the path of a converted graph
+	 * @return true iff the converted graph is stored in the cache, and must therefore outlive the benchmark session
+	 */
+	public boolean isCached(String path) {
+		return directory.equals(new File(path).getAbsoluteFile().getParentFile());
+	}
+}
@@ -19,7 +19,6 @@ import org.apache.commons.configuration.Configuration;
 import org.apache.logging.log4j.LogManager;
 import org.apache.logging.log4j.Logger;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
 
 import java.io.IOException;
 import java.util.ArrayList;
@@ -37,14 +36,16 @@ public abstract class GraphmatJob {
 
 	protected final Configuration config;
 	protected final String graphPath;
-	protected final Long2LongMap vertexTranslation;
+	protected final VertexTranslation vertexTranslation;
 	protected String outputPath;
 	protected String jobId;
+	protected String serverSocket;
 
-	public GraphmatJob(Configuration config, String graphPath, Long2LongMap vertexTranslation, String jobId) {
+	public GraphmatJob(Configuration config, String graphPath, VertexTranslation vertexTranslation, String jobId) {
 		this.config = config;
 		this.graphPath = graphPath;
 		this.outputPath = null;
+		this.serverSocket = null;
 		this.vertexTranslation = vertexTranslation;
 		this.jobId = jobId;
 	}
@@ -52,18 +53,35 @@ public abstract class GraphmatJob {
 	public void setOutputPath(String file) {
 		this.outputPath = file;
 	}
+
+	/**
+	 * Runs the job on a resident gmat-server listening on the given socket, instead of launching the executable.
+	 */
+	public void setServerSocket(String socket) {
+		this.serverSocket = socket;
+	}
 	
 	abstract protected String getExecutable();
 	abstract protected void addJobArguments(List<String> args);
 	
 	public void execute() throws IOException, InterruptedException {
 		List<String> args = new ArrayList<>();
-		args.add(graphPath);
+		if (serverSocket != null) {
+			args.add(serverSocket);
+			args.add(getExecutable());
+		} else {
+			args.add(graphPath);
+		}
 		addJobArguments(args);
 		
 		if (outputPath != null) {
 			args.add(outputPath);
 		}
+
+		if (serverSocket != null) {
+			GraphmatPlatform.runCommand("%s %s", GraphmatPlatform.SERVER_CLIENT_BINARY_NAME, args);
+			return;
+		}
 		
 		String cmdFormat = config.getString(GraphmatPlatform.RUN_COMMAND_FORMAT_KEY, "%s %s");
 		GraphmatPlatform.runCommand(cmdFormat, GraphmatPlatform.BINARY_DIRECTORY + "/" + getExecutable(), args);
@@ -19,7 +19,9 @@ import java.io.*;
 import java.math.BigDecimal;
 import java.nio.file.Path;
 import java.util.ArrayList;
+import java.util.HashMap;
 import java.util.List;
+import java.util.Map;
 
 import science.atlarge.granula.archiver.PlatformArchive;
 import science.atlarge.granula.modeller.job.JobModel;
@@ -44,8 +46,6 @@ import org.apache.commons.configuration.PropertiesConfiguration;
 import org.apache.logging.log4j.LogManager;
 import org.apache.logging.log4j.Logger;
 
-import it.unimi.dsi.fastutil.io.BinIO;
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
 import science.atlarge.graphalytics.execution.PlatformExecutionException;
 import science.atlarge.graphalytics.domain.algorithms.BreadthFirstSearchParameters;
 import science.atlarge.graphalytics.domain.algorithms.PageRankParameters;
@@ -76,13 +76,24 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 	public static final String GRANULA_ENABLE_KEY = "benchmark.run.granula.enabled";
 	public static final String RUN_COMMAND_FORMAT_KEY = "platform.graphmat.command.run";
 	public static final String CONVERT_COMMAND_FORMAT_KEY = "platform.graphmat.command.convert";
+	public static final String NUM_MACHINES_KEY = "platform.graphmat.num-machines";
 	public static final String INTERMEDIATE_DIR_KEY = "platform.graphmat.intermediate-dir";
+	public static final String CACHE_DIR_KEY = "platform.graphmat.cache-dir";
+	public static final String BINARY_OUTPUT_KEY = "platform.graphmat.output.binary";
+	public static final String REORDER_KEY = "platform.graphmat.reorder";
+	public static final String REAL_WEIGHT_TYPE_KEY = "platform.graphmat.weights.real-type";
+	public static final String SERVER_ENABLED_KEY = "platform.graphmat.server.enabled";
+	public static final String SERVER_TIMEOUT_KEY = "platform.graphmat.server.startup-timeout";
 
 	public static String BINARY_DIRECTORY = "./bin/standard";
-	public static final String MTX_CONVERT_BINARY_NAME = BINARY_DIRECTORY + "/graph_convert";
+	public static final String IMAGE_CONVERT_BINARY_NAME = BINARY_DIRECTORY + "/convert";
+	public static final String SERVER_BINARY_NAME = BINARY_DIRECTORY + "/gmat-server";
+	public static final String SERVER_CLIENT_BINARY_NAME = BINARY_DIRECTORY + "/gmat-client";
+
+	/** Resident servers started by loadGraph, by graph path. */
+	private static final Map<String, Process> servers = new HashMap<>();
 
 	private Configuration benchmarkConfig;
-	private Long2LongMap vertexTranslation;
 
 
 	private static final Logger LOG = LogManager.getLogger();
@@ -115,21 +126,12 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 
 	@Override
 	public LoadedGraph loadGraph(FormattedGraph formattedGraph) throws Exception {
-		LOG.info("Preprocessing graph \"{}\": generating intermediate mtx format.", formattedGraph.getName());
+		LOG.info("Preprocessing graph \"{}\": generating graph image.", formattedGraph.getName());
 
 		if (formattedGraph.getNumberOfVertices() > Integer.MAX_VALUE || formattedGraph.getNumberOfEdges() > Integer.MAX_VALUE) {
 			throw new IllegalArgumentException("GraphMat does not support more than " + Integer.MAX_VALUE + " vertices/edges");
 		}
 
-		String intermediateFile = createIntermediateFile(formattedGraph.getName(), "txt0");
-		String outputFile = createIntermediateFile(formattedGraph.getName(), "mtx");
-
-		// Convert from Graphalytics VE format to intermediate format
-		vertexTranslation = GraphConverter.parseAndWrite(formattedGraph, intermediateFile);
-                String vertexTranslationFile = createIntermediateFile(formattedGraph.getName() + "_vertex_translation", "bin");
-                BinIO.storeObject(vertexTranslation, vertexTranslationFile);
-                LOG.info("Stored vertex translation in: {}", vertexTranslationFile);
-
 		// Check if graph has weights
 		boolean isWeighted = false;
 		int weightType = 0;
@@ -147,7 +149,8 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 			if (t.equals(PropertyType.INTEGER)) {
 				weightType = 0;
 			}  else if (t.equals(PropertyType.REAL)) {
-				weightType = 1;
+				// Real weights are stored as double (1) or, to halve the size of the image, as float (2)
+				weightType = benchmarkConfig.getString(REAL_WEIGHT_TYPE_KEY, "double").equals("float") ? 2 : 1;
 			} else {
 				throw new IllegalArgumentException(
 						"GraphMat does not support properties of type: " + t);
@@ -157,7 +160,7 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 		}
 
 
-		// Convert from intermediate format to MTX format
+		// Convert from Graphalytics VE format to a GraphMat graph image
 		boolean isDirected = formattedGraph.isDirected();
 		String cmdFormat = benchmarkConfig.getString(CONVERT_COMMAND_FORMAT_KEY, "%s %s");
 		List<String> args = new ArrayList<>();
@@ -166,30 +169,63 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 		args.add("--selfloops=0");
 		args.add("--duplicatededges=0");
 		if (!isDirected) args.add("--bidirectional");
-		args.add("--inputformat=1");
-		args.add("--outputformat=2");
-		args.add("--inputheader=0");
-		args.add("--outputheader=1");
-		args.add("--inputedgeweights=" + (isWeighted ? "1" : "0"));
-		args.add("--outputedgeweights=" + (isWeighted ? "1" : "2"));
+		args.add("--edgeweights=" + (isWeighted ? "1" : "0"));
 		args.add("--edgeweighttype=" + weightType);
-		//args.add("--split=16");
-		//args.add(intermediateFile);
-		args.add(intermediateFile.substring(0, intermediateFile.length()-1));
-		args.add(outputFile);
-		runCommand(cmdFormat, MTX_CONVERT_BINARY_NAME, args);
+		args.add("--parts=" + benchmarkConfig.getInt(NUM_MACHINES_KEY, 1));
+		args.add("--reorder=" + benchmarkConfig.getString(REORDER_KEY, "none"));
+
+		// Reuse the graph image of an earlier session if neither the input nor the flags changed
+		GraphCache cache = getGraphCache();
+		String cacheKey = null;
+		String outputFile;
+		if (cache != null) {
+			cacheKey = GraphCache.key(args, formattedGraph.getVertexFilePath(), formattedGraph.getEdgeFilePath());
+			outputFile = cache.pathOf(cacheKey);
+		} else {
+			outputFile = createIntermediateFile(formattedGraph.getName(), "img");
+		}
 
+		if (cache != null && cache.contains(cacheKey)) {
+			LOG.info("Reusing cached graph image: {}", outputFile);
+		} else {
+			args.add(formattedGraph.getVertexFilePath());
+			args.add(formattedGraph.getEdgeFilePath());
+			args.add(outputFile);
+			runCommand(cmdFormat, IMAGE_CONVERT_BINARY_NAME, args);
+			LOG.info("Stored vertex translation in: {}", VertexTranslation.pathOf(outputFile));
+
+			if (cache != null) {
+				cache.commit(cacheKey);
+			}
+		}
+
+		if (benchmarkConfig.getBoolean(SERVER_ENABLED_KEY, false)) {
+			startServer(outputFile);
+		}
 
-		tryDeleteIntermediateFile(intermediateFile);
 		return new LoadedGraph(formattedGraph, null, outputFile);
 	}
 
 	@Override
 	public void deleteGraph(LoadedGraph loadedGraph) {
-		// TODO parametrize graph conversion splits
-		for (int i = 0; i < 16; i++) {
+		stopServer(loadedGraph.getEdgePath());
+
+		GraphCache cache;
+		try {
+			cache = getGraphCache();
+		} catch (IOException e) {
+			cache = null;
+		}
+		if (cache != null && cache.isCached(loadedGraph.getEdgePath())) {
+			return;
+		}
+
+		// The graph image has one part per machine it was converted for
+		for (int i = 0; new File(loadedGraph.getEdgePath() + i).exists(); i++) {
 			tryDeleteIntermediateFile(loadedGraph.getEdgePath() + i);
 		}
+		tryDeleteIntermediateFile(VertexTranslation.pathOf(loadedGraph.getEdgePath()));
+		tryDeleteIntermediateFile(VertexTranslation.indexPathOf(loadedGraph.getEdgePath()));
 	}
 
 
@@ -215,17 +251,12 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 		Object params = benchmarkRun.getAlgorithmParameters();
 		GraphmatJob job;
 
-		Long2LongMap vertexTranslation = null;
 		String graphFile = runtimeSetup.getLoadedGraph().getEdgePath();
+		VertexTranslation vertexTranslation;
 		try {
-			String vertexTranslationFile = createIntermediateFile(benchmarkRun.getFormattedGraph().getName() + "_vertex_translation", "bin");
-			try {
-				vertexTranslation = (Long2LongMap) BinIO.loadObject(vertexTranslationFile);
-			} catch (ClassNotFoundException e) {
-				e.printStackTrace();
-			}
+			vertexTranslation = VertexTranslation.open(graphFile);
 		} catch (IOException e) {
-			e.printStackTrace();
+			throw new PlatformExecutionException("failed to open vertex translation", e);
 		}
 
 		boolean isDirected = benchmarkRun.getGraph().isDirected();
@@ -257,19 +288,29 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 				throw new PlatformExecutionException("Not yet implemented.");
 		}
 
+		String serverSocket = serverSocketPath(graphFile);
+		if (benchmarkConfig.getBoolean(SERVER_ENABLED_KEY, false) && new File(serverSocket).exists()) {
+			job.setServerSocket(serverSocket);
+		}
+
 		String intermediateOutputPath = null;
 		boolean outputEnabled = benchmarkRunSetup.isOutputRequired();
+		boolean binaryOutput = benchmarkConfig.getBoolean(BINARY_OUTPUT_KEY, false);
+		Path outputFile = benchmarkRunSetup.getOutputDir().resolve(benchmarkRun.getName());
 
 		try{
-			if (outputEnabled) {
-				intermediateOutputPath = createIntermediateFile("output", "txt0");
+			// The binaries translate vertex ids themselves, so text output is written straight to the output
+			// directory. Binary output is written to an intermediate file and translated afterwards.
+			if (outputEnabled && binaryOutput) {
+				intermediateOutputPath = createIntermediateFile("output", "bin");
 				job.setOutputPath(intermediateOutputPath);
+			} else if (outputEnabled) {
+				job.setOutputPath(outputFile.toAbsolutePath().toString());
 			}
 
 			job.execute();
 
-			if (outputEnabled) {
-				Path outputFile = benchmarkRunSetup.getOutputDir().resolve(benchmarkRun.getName());
+			if (outputEnabled && binaryOutput) {
 				OutputConverter.parseAndWrite(
 						intermediateOutputPath,
 						outputFile.toAbsolutePath().toString(),
@@ -427,6 +468,87 @@ public class GraphmatPlatform implements GranulaAwarePlatform {
 		}
 	}
 
+	/**
+	 * @param graphPath the path of a converted graph
+	 * @return the socket of the resident server for the graph; kept short, since socket paths are limited in length
+	 */
+	public static String serverSocketPath(String graphPath) {
+		String name = String.format("gmat-%08x.sock", new File(graphPath).getAbsolutePath().hashCode());
+		return new File(System.getProperty("java.io.tmpdir"), name).getPath();
+	}
+
+	/**
+	 * Starts a gmat-server that keeps the graph resident for all jobs run on it, and waits until it accepts jobs.
+	 */
+	private void startServer(String graphPath) throws IOException, InterruptedException {
+		String socket = serverSocketPath(graphPath);
+		String cmdFormat = benchmarkConfig.getString(RUN_COMMAND_FORMAT_KEY, "%s %s");
+		String cmd = String.format(cmdFormat, SERVER_BINARY_NAME, graphPath + " " + socket);
+		LOG.info("starting server: {}", cmd);
+
+		ProcessBuilder pb = new ProcessBuilder(cmd.split(" "));
+		pb.redirectErrorStream(true);
+		pb.redirectOutput(ProcessBuilder.Redirect.appendTo(new File(graphPath + ".server.log")));
+		Process process = pb.start();
+
+		long deadline = System.currentTimeMillis() + 1000L * benchmarkConfig.getInt(SERVER_TIMEOUT_KEY, 300);
+		while (!pingServer(socket)) {
+			try {
+				int exit = process.exitValue();
+				throw new IOException("server exited with code " + exit + " before accepting jobs");
+			} catch (IllegalThreadStateException e) {
+				// still starting
+			}
+			if (System.currentTimeMillis() > deadline) {
+				process.destroy();
+				throw new IOException("server did not start within the timeout");
+			}
+			Thread.sleep(200);
+		}
+
+		synchronized (servers) {
+			servers.put(graphPath, process);
+		}
+	}
+
+	private void stopServer(String graphPath) {
+		Process process;
+		synchronized (servers) {
+			process = servers.remove(graphPath);
+		}
+		if (process == null) {
+			return;
+		}
+
+		try {
+			List<String> args = new ArrayList<>();
+			args.add(serverSocketPath(graphPath));
+			args.add("quit");
+			runCommand("%s %s", SERVER_CLIENT_BINARY_NAME, args);
+			process.waitFor();
+		} catch (IOException | InterruptedException e) {
+			LOG.warn("failed to stop server for '{}'", graphPath);
+			process.destroy();
+		}
+		tryDeleteIntermediateFile(graphPath + ".server.log");
+	}
+
+	private static boolean pingServer(String socket) throws IOException, InterruptedException {
+		if (!new File(socket).exists()) {
+			return false;
+		}
+		Process ping = new ProcessBuilder(SERVER_CLIENT_BINARY_NAME, socket, "ping").redirectErrorStream(true).start();
+		while (ping.getInputStream().read() >= 0) {
+			// discard the reply
+		}
+		return ping.waitFor() == 0;
+	}
+
+	private GraphCache getGraphCache() throws IOException {
+		String dir = benchmarkConfig.getString(CACHE_DIR_KEY, null);
+		return dir != null && !dir.isEmpty() ? new GraphCache(dir) : null;
+	}
+
 	private void tryDeleteIntermediateFile(String path) {
 		if (!new File(path).delete()) {
 			LOG.warn("failed to delete intermediate file '{}'", path);
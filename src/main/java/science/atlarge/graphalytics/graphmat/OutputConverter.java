@@ -16,30 +16,42 @@
 package science.atlarge.graphalytics.graphmat;
 
 import java.io.BufferedReader;
+import java.io.BufferedWriter;
+import java.io.EOFException;
+import java.io.FileInputStream;
 import java.io.FileReader;
 import java.io.FileWriter;
 import java.io.IOException;
 import java.io.PrintWriter;
-
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
-import it.unimi.dsi.fastutil.longs.Long2LongOpenHashMap;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
 
 public class OutputConverter {
 
-	public static void parseAndWrite(String inputFile, String outputFile, Long2LongMap vertexTranslation) throws IOException {
+	/** Magic bytes at the start of binary output files written by the GraphMat binaries. */
+	private static final byte[] BINARY_MAGIC = "GMOUTPUT".getBytes(StandardCharsets.US_ASCII);
+	private static final int BINARY_HEADER_SIZE = 24;
+
+	private static final int UINT32 = 0;
+	private static final int INT32 = 1;
+	private static final int DOUBLE = 2;
+
+	public static void parseAndWrite(String inputFile, String outputFile, VertexTranslation vertexTranslation) throws IOException {
                 parseAndWrite(inputFile, outputFile, vertexTranslation, false);
         }
 
-	public static void parseAndWrite(String inputFile, String outputFile, Long2LongMap vertexTranslation, boolean translateVertexProperty) throws IOException {
+	public static void parseAndWrite(String inputFile, String outputFile, VertexTranslation vertexTranslation, boolean translateVertexProperty) throws IOException {
+		if (isBinaryOutput(inputFile)) {
+			parseAndWriteBinary(inputFile, outputFile, vertexTranslation, translateVertexProperty);
+			return;
+		}
+
 		try (BufferedReader r = new BufferedReader(new FileReader(inputFile));
 				PrintWriter p = new PrintWriter(new FileWriter(outputFile))) {
 
-			// Flip vertex translation, since we need to translate from new vertex ids to old vertex ids
-			Long2LongMap revVertexTranslation = new Long2LongOpenHashMap();
-			for (Long2LongMap.Entry e: vertexTranslation.long2LongEntrySet()) {
-				revVertexTranslation.put(e.getLongValue(), e.getLongKey());
-			}
-
 			String line;
 
 			while ((line = r.readLine()) != null) {
@@ -48,11 +60,11 @@ public class OutputConverter {
 				if (parts.length == 2) {
 					long vertexId = Long.parseLong(parts[0]);
 
-					p.print(revVertexTranslation.get(vertexId));
+					p.print(vertexTranslation.toOriginal(vertexId));
 					p.print(" ");
                                         if (translateVertexProperty) {
                                             long vertexProperty = Long.parseLong(parts[1]);
-                                            p.print(revVertexTranslation.get(vertexProperty));
+                                            p.print(vertexTranslation.toOriginal(vertexProperty));
                                         } else {
                                             p.print(parts[1]);
                                         }
@@ -65,4 +77,101 @@ public class OutputConverter {
 
 		}
 	}
+
+	private static boolean isBinaryOutput(String inputFile) throws IOException {
+		try (FileInputStream in = new FileInputStream(inputFile)) {
+			byte[] magic = new byte[BINARY_MAGIC.length];
+			int n = in.read(magic);
+			return n == magic.length && Arrays.equals(magic, BINARY_MAGIC);
+		}
+	}
+
+	/**
+	 * Streams a binary output file: a header with the value type and the number of vertices, followed by a column of
+	 * int32 vertex ids and a column of values. Both columns are read side by side, so the file is never loaded
+	 * as a whole. Unreachable vertices are stored as the maximum value of the type and printed as in the text
+	 * output.
+	 */
+	private static void parseAndWriteBinary(String inputFile, String outputFile, VertexTranslation vertexTranslation,
+			boolean translateVertexProperty) throws IOException {
+		try (FileChannel channel = new FileInputStream(inputFile).getChannel();
+				PrintWriter p = new PrintWriter(new BufferedWriter(new FileWriter(outputFile), 1 << 20))) {
+
+			ByteBuffer header = ByteBuffer.allocate(BINARY_HEADER_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+			readFully(channel, header, 0);
+			header.position(BINARY_MAGIC.length + 4);
+			int valueType = header.getInt();
+			long nvertices = header.getLong();
+
+			int valueSize = valueType == DOUBLE ? 8 : 4;
+			ColumnReader ids = new ColumnReader(channel, BINARY_HEADER_SIZE);
+			ColumnReader values = new ColumnReader(channel, BINARY_HEADER_SIZE + 4 * nvertices);
+
+			for (long i = 0; i < nvertices; i++) {
+				long vertexId = ids.next(4).getInt();
+
+				p.print(vertexTranslation.toOriginal(vertexId));
+				p.print(" ");
+				ByteBuffer value = values.next(valueSize);
+				switch (valueType) {
+					case UINT32:
+						long depth = value.getInt() & 0xFFFFFFFFL;
+						p.print(depth == 0xFFFFFFFFL ? Long.MAX_VALUE : depth);
+						break;
+					case INT32:
+						long label = value.getInt();
+						p.print(translateVertexProperty ? vertexTranslation.toOriginal(label) : label);
+						break;
+					case DOUBLE:
+						double score = value.getDouble();
+						p.print(score == Double.MAX_VALUE ? "inf" : Double.toString(score));
+						break;
+					default:
+						throw new IOException("Unknown value type " + valueType + " in " + inputFile);
+				}
+				p.print("\n");
+			}
+		}
+	}
+
+	private static void readFully(FileChannel channel, ByteBuffer buffer, long position) throws IOException {
+		while (buffer.hasRemaining()) {
+			int n = channel.read(buffer, position);
+			if (n < 0) {
+				throw new EOFException();
+			}
+			position += n;
+		}
+		buffer.flip();
+	}
+
+	/**
+	 * Sequential reader of one column of a binary output file.
+	 */
+	private static class ColumnReader {
+		private final FileChannel channel;
+		private final ByteBuffer buffer = ByteBuffer.allocateDirect(1 << 20).order(ByteOrder.LITTLE_ENDIAN);
+		private long position;
+
+		ColumnReader(FileChannel channel, long position) {
+			this.channel = channel;
+			this.position = position;
+			buffer.flip();
+		}
+
+		ByteBuffer next(int size) throws IOException {
+			if (buffer.remaining() < size) {
+				buffer.compact();
+				while (buffer.position() < size) {
+					int n = channel.read(buffer, position);
+					if (n < 0) {
+						throw new EOFException();
+					}
+					position += n;
+				}
+				buffer.flip();
+			}
+			return buffer;
+		}
+	}
 }
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2015 Delft University of Technology
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package science.atlarge.graphalytics.graphmat;
+
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.nio.ByteOrder;
+import java.nio.LongBuffer;
+import java.nio.channels.FileChannel;
+
+/**
+ * Vertex translation written by the native converter. The file holds the original id of every vertex as a
+ * little-endian 64-bit integer, ordered by the (dense, 1-based) vertex id in the converted graph, and is mapped
+ * rather than read, so opening it costs nothing regardless of the size of the graph. The same file is used by the
+ * GraphMat binaries to write their output with the original vertex ids.
+ *
+ * Next to it, the converter writes the vertex index: the vertex ids in the converted graph, ordered by their original
+ * id, so that an original id is looked up by binary search instead of a scan of the translation.
+ */
+public final class VertexTranslation {
+
+	public static final String FILE_EXTENSION = ".ids";
+	public static final String INDEX_EXTENSION = ".ids.index";
+
+	private static final int SEGMENT_SHIFT = 27;
+	private static final long SEGMENT_SIZE = 1L << SEGMENT_SHIFT;
+	private static final long INVALID_ID = -1;
+
+	private final LongBuffer[] segments;
+	private final LongBuffer[] indexSegments;
+	private final long nvertices;
+
+	private VertexTranslation(LongBuffer[] segments, LongBuffer[] indexSegments, long nvertices) {
+		this.segments = segments;
+		this.indexSegments = indexSegments;
+		this.nvertices = nvertices;
+	}
+
+	/**
+	 * @param graphPath the path of the converted graph
+	 * @return the path of the vertex translation belonging to the converted graph
+	 */
+	public static String pathOf(String graphPath) {
+		return graphPath + FILE_EXTENSION;
+	}
+
+	/**
+	 * @param graphPath the path of the converted graph
+	 * @return the path of the vertex index belonging to the converted graph
+	 */
+	public static String indexPathOf(String graphPath) {
+		return graphPath + INDEX_EXTENSION;
+	}
+
+	/**
+	 * Maps the vertex translation of a converted graph.
+	 *
+	 * @param graphPath the path of the converted graph
+	 * @return the vertex translation of the graph
+	 * @throws IOException iff the translation file could not be mapped
+	 */
+	public static VertexTranslation open(String graphPath) throws IOException {
+		LongBuffer[] segments = map(pathOf(graphPath));
+		// Graphs converted before the index was introduced fall back to scanning the translation
+		LongBuffer[] indexSegments = new File(indexPathOf(graphPath)).exists() ? map(indexPathOf(graphPath)) : null;
+		long nvertices = 0;
+		for (LongBuffer segment : segments) {
+			nvertices += segment.limit();
+		}
+		return new VertexTranslation(segments, indexSegments, nvertices);
+	}
+
+	private static LongBuffer[] map(String path) throws IOException {
+		try (FileChannel channel = new FileInputStream(path).getChannel()) {
+			long nvalues = channel.size() / 8;
+			LongBuffer[] segments = new LongBuffer[(int) ((nvalues + SEGMENT_SIZE - 1) / SEGMENT_SIZE)];
+
+			for (int i = 0; i < segments.length; i++) {
+				long first = i * SEGMENT_SIZE;
+				long length = Math.min(SEGMENT_SIZE, nvalues - first);
+				segments[i] = channel.map(FileChannel.MapMode.READ_ONLY, first * 8, length * 8)
+						.order(ByteOrder.LITTLE_ENDIAN).asLongBuffer();
+			}
+
+			return segments;
+		}
+	}
+
+	public long getNumberOfVertices() {
+		return nvertices;
+	}
+
+	/**
+	 * @param vertexId a vertex id in the converted graph
+	 * @return the id of the vertex in the original graph
+	 */
+	public long toOriginal(long vertexId) {
+		return get(segments, vertexId - 1);
+	}
+
+	/**
+	 * Looks up the id of an original vertex in the converted graph, by binary search in the vertex index.
+	 *
+	 * @param originalId a vertex id in the original graph
+	 * @return the id of the vertex in the converted graph, or -1 if the vertex does not exist
+	 */
+	public long toInternal(long originalId) {
+		if (indexSegments == null) {
+			return scanForInternal(originalId);
+		}
+
+		long low = 0;
+		long high = nvertices;
+		while (low < high) {
+			long middle = (low + high) >>> 1;
+			long vertexId = get(indexSegments, middle);
+			long middleId = toOriginal(vertexId);
+			if (middleId == originalId) {
+				return vertexId;
+			} else if (middleId < originalId) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		return INVALID_ID;
+	}
+
+	private long scanForInternal(long originalId) {
+		for (int i = 0; i < segments.length; i++) {
+			LongBuffer segment = segments[i];
+			for (int j = 0; j < segment.limit(); j++) {
+				if (segment.get(j) == originalId) {
+					return i * SEGMENT_SIZE + j + 1;
+				}
+			}
+		}
+		return INVALID_ID;
+	}
+
+	private static long get(LongBuffer[] segments, long index) {
+		return segments[(int) (index >>> SEGMENT_SHIFT)].get((int) (index & (SEGMENT_SIZE - 1)));
+	}
+}
@@ -20,7 +20,7 @@ import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 
 import java.util.List;
 
@@ -35,7 +35,7 @@ public final class BreadthFirstSearchJob extends GraphmatJob {
 
 	private final BreadthFirstSearchParameters params;
 
-	public BreadthFirstSearchJob(Configuration config, String graphPath, Long2LongMap vertexTranslation, BreadthFirstSearchParameters params, String jobId) {
+	public BreadthFirstSearchJob(Configuration config, String graphPath, VertexTranslation vertexTranslation, BreadthFirstSearchParameters params, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
 		this.params = params;
 	}
@@ -48,7 +48,7 @@ public final class BreadthFirstSearchJob extends GraphmatJob {
 	@Override
 	protected void addJobArguments(List<String> args) {
 		long oldSource = params.getSourceVertex();
-		long newSource = vertexTranslation.get(oldSource);
+		long newSource = vertexTranslation.toInternal(oldSource);
 		
 		args.add(Long.toString(newSource));
 		args.add(jobId);
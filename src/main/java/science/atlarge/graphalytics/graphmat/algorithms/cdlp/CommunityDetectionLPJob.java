@@ -19,7 +19,7 @@ import java.util.List;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 import science.atlarge.graphalytics.domain.algorithms.CommunityDetectionLPParameters;
 import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
@@ -28,7 +28,7 @@ public class CommunityDetectionLPJob extends GraphmatJob {
 	private final CommunityDetectionLPParameters params;
         private String isDirected;
 
-	public CommunityDetectionLPJob(Configuration config, String graphPath, String isDirected, Long2LongMap vertexTranslation, CommunityDetectionLPParameters params, String jobId) {
+	public CommunityDetectionLPJob(Configuration config, String graphPath, String isDirected, VertexTranslation vertexTranslation, CommunityDetectionLPParameters params, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
 		this.params = params;
                 this.isDirected = isDirected;
@@ -19,14 +19,14 @@ import java.util.List;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
 public class LocalClusteringCoefficientJob extends GraphmatJob {
 
         private String isDirected;
 
-	public LocalClusteringCoefficientJob(Configuration config, String graphPath, String isDirected, Long2LongMap vertexTranslation, String jobId) {
+	public LocalClusteringCoefficientJob(Configuration config, String graphPath, String isDirected, VertexTranslation vertexTranslation, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
                 this.isDirected = isDirected;
 	}
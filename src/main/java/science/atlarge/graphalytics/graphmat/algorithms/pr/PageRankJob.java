@@ -19,7 +19,7 @@ import java.util.List;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 import science.atlarge.graphalytics.domain.algorithms.PageRankParameters;
 import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
@@ -31,6 +31,12 @@ import science.atlarge.graphalytics.graphmat.GraphmatJob;
  */
 public final class PageRankJob extends GraphmatJob {
 
+	/** L1 tolerance of the convergence-based PageRank; 0 runs the fixed number of iterations. */
+	public static final String TOLERANCE_KEY = "platform.graphmat.pr.tolerance";
+
+	/** Type of the contributions sent by the fixed-iteration PageRank: double or float. */
+	public static final String MESSAGE_TYPE_KEY = "platform.graphmat.pr.message-type";
+
 	private final PageRankParameters params;
 	
 	/**
@@ -40,7 +46,7 @@ public final class PageRankJob extends GraphmatJob {
 	 * @param graphInputPath   the path of the input graph
 	 * @param graphOutputPath  the path of the output graph
 	 */
-	public PageRankJob(Configuration config, String graphPath, Long2LongMap vertexTranslation, PageRankParameters params, String jobId) {
+	public PageRankJob(Configuration config, String graphPath, VertexTranslation vertexTranslation, PageRankParameters params, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
 		this.params = params;
 	}
@@ -54,6 +60,8 @@ public final class PageRankJob extends GraphmatJob {
 	protected void addJobArguments(List<String> args) {
 		args.add(Integer.toString(params.getNumberOfIterations()));
 		args.add(Double.toString(params.getDampingFactor()));
+		args.add(Double.toString(config.getDouble(TOLERANCE_KEY, 0.0)));
+		args.add(config.getString(MESSAGE_TYPE_KEY, "double"));
 		args.add(jobId);
 	}
 
@@ -20,7 +20,7 @@ import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 
 import java.util.List;
 
@@ -33,9 +33,12 @@ import java.util.List;
  */
 public final class SingleSourceShortestPathJob extends GraphmatJob {
 
+	/** Bucket width of the delta-stepping search; 0 lets the executable pick it from the edge weights. */
+	public static final String DELTA_KEY = "platform.graphmat.sssp.delta";
+
 	private final SingleSourceShortestPathsParameters params;
 
-	public SingleSourceShortestPathJob(Configuration config, String graphPath, Long2LongMap vertexTranslation, SingleSourceShortestPathsParameters params, String jobId) {
+	public SingleSourceShortestPathJob(Configuration config, String graphPath, VertexTranslation vertexTranslation, SingleSourceShortestPathsParameters params, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
 		this.params = params;
 	}
@@ -48,9 +51,10 @@ public final class SingleSourceShortestPathJob extends GraphmatJob {
 	@Override
 	protected void addJobArguments(List<String> args) {
 		long oldSource = params.getSourceVertex();
-		long newSource = vertexTranslation.get(oldSource);
+		long newSource = vertexTranslation.toInternal(oldSource);
 		
 		args.add(Long.toString(newSource));
+		args.add(Double.toString(config.getDouble(DELTA_KEY, 0.0)));
 		args.add(jobId);
 	}
 }
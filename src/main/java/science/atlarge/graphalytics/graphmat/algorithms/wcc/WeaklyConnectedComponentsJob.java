@@ -19,12 +19,12 @@ import java.util.List;
 
 import org.apache.commons.configuration.Configuration;
 
-import it.unimi.dsi.fastutil.longs.Long2LongMap;
+import science.atlarge.graphalytics.graphmat.VertexTranslation;
 import science.atlarge.graphalytics.graphmat.GraphmatJob;
 
 public class WeaklyConnectedComponentsJob extends GraphmatJob {
 
-	public WeaklyConnectedComponentsJob(Configuration config, String graphPath, Long2LongMap vertexTranslation, String jobId) {
+	public WeaklyConnectedComponentsJob(Configuration config, String graphPath, VertexTranslation vertexTranslation, String jobId) {
 		super(config, graphPath, vertexTranslation, jobId);
 	}
 